@@ -0,0 +1,404 @@
+/*
+ * BLAKE3, the portable implementation
+ *
+ * Written after the BLAKE3 specification and the reference
+ * implementation by Jack O'Connor, Jean-Philippe Aumasson,
+ * Samuel Neves and Zooko Wilcox-O'Hearn
+ * https://github.com/BLAKE3-team/BLAKE3-specs
+ *
+ * The input is split into 1KB chunks. Each chunk is hashed on
+ * its own, then chaining values of the chunks are merged pairwise
+ * into a binary tree. Only the subtrees that are not complete yet
+ * are kept in the stack, so the state has a fixed size.
+ */
+
+#include "blake3_internal.h"
+#include <string.h>
+
+/* the initialization vector */
+const uint32_t blake3_IV[8] =
+{
+    0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL,
+    0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL
+};
+
+/* the message words used by every round */
+const uint8_t blake3_MSG_SCHEDULE[7][16] =
+{
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13}
+};
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define LOAD32L(x, y) \
+    { \
+        x = ((uint32_t)((y)[0] & 255)) | (((uint32_t)((y)[1] & 255))<<8) | \
+        (((uint32_t)((y)[2] & 255))<<16) | (((uint32_t)((y)[3] & 255))<<24); \
+    }
+
+#define STORE32L(x, y) \
+    { \
+        (y)[0] = (unsigned char)((x)&255); (y)[1] = (unsigned char)(((x)>>8)&255); \
+        (y)[2] = (unsigned char)(((x)>>16)&255); (y)[3] = (unsigned char)(((x)>>24)&255); \
+    }
+
+#ifndef MIN
+#define MIN(x, y) ( ((x)<(y))?(x):(y) )
+#endif
+
+/* the mixing function */
+#define G(a, b, c, d, x, y) \
+    { \
+        v[a] = v[a] + v[b] + (x); v[d] = ROR32(v[d] ^ v[a], 16); \
+        v[c] = v[c] + v[d];       v[b] = ROR32(v[b] ^ v[c], 12); \
+        v[a] = v[a] + v[b] + (y); v[d] = ROR32(v[d] ^ v[a], 8);  \
+        v[c] = v[c] + v[d];       v[b] = ROR32(v[b] ^ v[c], 7);  \
+    }
+
+/* compress one 512-bit block, all 16 words of the result are returned */
+static void blake3_compress(const uint32_t cv[8], const unsigned char block[BLAKE3_BLOCK_LEN],
+                            uint8_t block_len, uint64_t counter, uint8_t flags, uint32_t out[16])
+{
+    uint32_t m[16], v[16];
+    int i;
+
+    for (i = 0; i < 16; i++)
+    {
+        LOAD32L(m[i], block + (4*i));
+    }
+
+    for (i = 0; i < 8; i++)
+    {
+        v[i] = cv[i];
+    }
+    v[8] = blake3_IV[0];
+    v[9] = blake3_IV[1];
+    v[10] = blake3_IV[2];
+    v[11] = blake3_IV[3];
+    v[12] = (uint32_t)counter;
+    v[13] = (uint32_t)(counter >> 32);
+    v[14] = block_len;
+    v[15] = flags;
+
+    /* the rounds are unrolled to let the schedule be resolved at compile time */
+    #define ROUND(r) \
+        { \
+            const uint8_t *s = blake3_MSG_SCHEDULE[r]; \
+            /* columns */ \
+            G(0, 4, 8, 12, m[s[0]], m[s[1]]); \
+            G(1, 5, 9, 13, m[s[2]], m[s[3]]); \
+            G(2, 6, 10, 14, m[s[4]], m[s[5]]); \
+            G(3, 7, 11, 15, m[s[6]], m[s[7]]); \
+            /* diagonals */ \
+            G(0, 5, 10, 15, m[s[8]], m[s[9]]); \
+            G(1, 6, 11, 12, m[s[10]], m[s[11]]); \
+            G(2, 7, 8, 13, m[s[12]], m[s[13]]); \
+            G(3, 4, 9, 14, m[s[14]], m[s[15]]); \
+        }
+
+    ROUND(0);
+    ROUND(1);
+    ROUND(2);
+    ROUND(3);
+    ROUND(4);
+    ROUND(5);
+    ROUND(6);
+
+    #undef ROUND
+
+    for (i = 0; i < 8; i++)
+    {
+        out[i] = v[i] ^ v[i + 8];
+        out[i + 8] = v[i + 8] ^ cv[i];
+    }
+}
+
+/* the chaining value is the first half of the compression result */
+static void blake3_compress_cv(uint32_t cv[8], const unsigned char block[BLAKE3_BLOCK_LEN],
+                               uint8_t block_len, uint64_t counter, uint8_t flags)
+{
+    uint32_t out[16];
+    int i;
+
+    blake3_compress(cv, block, block_len, counter, flags, out);
+
+    for (i = 0; i < 8; i++)
+    {
+        cv[i] = out[i];
+    }
+}
+
+/* merge chaining values of two subtrees */
+static void blake3_parent_cv(const uint32_t left[8], const uint32_t right[8],
+                             const uint32_t key[8], uint32_t out[8])
+{
+    unsigned char block[BLAKE3_BLOCK_LEN];
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        STORE32L(left[i], block + (4*i));
+        STORE32L(right[i], block + 32 + (4*i));
+    }
+
+    memcpy(out, key, 8 * sizeof(uint32_t));
+    blake3_compress_cv(out, block, BLAKE3_BLOCK_LEN, 0, PARENT);
+}
+
+static void blake3_chunk_init(blake3_chunk_state *chunk, const uint32_t key[8], uint64_t chunk_counter)
+{
+    memcpy(chunk->cv, key, 8 * sizeof(uint32_t));
+    chunk->chunk_counter = chunk_counter;
+    memset(chunk->buf, 0, BLAKE3_BLOCK_LEN);
+    chunk->buf_len = 0;
+    chunk->blocks_compressed = 0;
+    chunk->flags = 0;
+}
+
+/* bytes of the current chunk taken so far */
+static size_t blake3_chunk_len(const blake3_chunk_state *chunk)
+{
+    return (BLAKE3_BLOCK_LEN * (size_t)chunk->blocks_compressed) + (size_t)chunk->buf_len;
+}
+
+static uint8_t blake3_chunk_start_flag(const blake3_chunk_state *chunk)
+{
+    return chunk->blocks_compressed == 0 ? CHUNK_START : 0;
+}
+
+static void blake3_chunk_update(blake3_chunk_state *chunk, const unsigned char *in, size_t inlen)
+{
+    while (inlen > 0)
+    {
+        size_t n;
+
+        /* the last block of a chunk is kept until it's known to be the last */
+        if (chunk->buf_len == BLAKE3_BLOCK_LEN)
+        {
+            blake3_compress_cv(chunk->cv, chunk->buf, BLAKE3_BLOCK_LEN, chunk->chunk_counter,
+                               (uint8_t)(chunk->flags | blake3_chunk_start_flag(chunk)));
+            chunk->blocks_compressed++;
+            chunk->buf_len = 0;
+            memset(chunk->buf, 0, BLAKE3_BLOCK_LEN);
+        }
+
+        n = MIN(inlen, (size_t)(BLAKE3_BLOCK_LEN - chunk->buf_len));
+        memcpy(chunk->buf + chunk->buf_len, in, n);
+        chunk->buf_len = (uint8_t)(chunk->buf_len + n);
+        in += n;
+        inlen -= n;
+    }
+}
+
+/* chaining value of a complete chunk */
+static void blake3_chunk_cv(const blake3_chunk_state *chunk, uint32_t cv[8])
+{
+    memcpy(cv, chunk->cv, 8 * sizeof(uint32_t));
+    blake3_compress_cv(cv, chunk->buf, chunk->buf_len, chunk->chunk_counter,
+                       (uint8_t)(chunk->flags | blake3_chunk_start_flag(chunk) | CHUNK_END));
+}
+
+/*
+   Push the chaining value of a complete chunk into the stack. Every
+   trailing zero bit of the number of chunks means a complete subtree,
+   which is merged with its left neighbour from the stack
+*/
+static void blake3_push_cv(blake3_hasher *md, uint32_t cv[8], uint64_t total_chunks)
+{
+    while ((total_chunks & 1) == 0)
+    {
+        md->cv_stack_len--;
+        blake3_parent_cv(md->cv_stack[md->cv_stack_len], cv, md->key, cv);
+        total_chunks >>= 1;
+    }
+
+    memcpy(md->cv_stack[md->cv_stack_len], cv, 8 * sizeof(uint32_t));
+    md->cv_stack_len++;
+}
+
+/* the kernel for whole chunks chosen for this CPU, none until blake3_select_kernel() */
+static blake3_chunks_fn blake3_hash_chunks = NULL;
+
+/**
+   Pick the fastest kernel supported by the CPU the program
+   is running on. One static binary serves different hosts,
+   so the choice is made at startup rather than at compile time
+*/
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((constructor))
+#endif
+static void blake3_select_kernel(void)
+{
+#if BLAKE3_X86
+    if (blake3_cpu_has_avx2())
+    {
+        blake3_hash_chunks = blake3_hash_chunks_avx2;
+    }
+#endif
+}
+
+/**
+   Name of the kernel in use
+   @return "avx2" or "portable"
+*/
+const char *blake3_kernel_name(void)
+{
+#if BLAKE3_X86
+    if (blake3_hash_chunks == blake3_hash_chunks_avx2)
+    {
+        return "avx2";
+    }
+#endif
+    return "portable";
+}
+
+
+/**
+   Initialize the hash state
+   @param md   The hash state you wish to initialize
+   @return 0 if successful
+*/
+int blake3_init(blake3_hasher *md)
+{
+    if (md == NULL) return 1;
+
+    memset(md, 0, sizeof(blake3_hasher));
+    memcpy(md->key, blake3_IV, 8 * sizeof(uint32_t));
+    blake3_chunk_init(&md->chunk, md->key, 0);
+
+    return 0;
+}
+
+
+/**
+   Process a block of memory though the hash
+   @param md     The hash state
+   @param in     The data to hash
+   @param inlen  The length of the data (octets)
+   @return 0 if successful
+*/
+int blake3_update(blake3_hasher *md, const unsigned char *in, size_t inlen)
+{
+    if (md == NULL) return 1;
+    if (in == NULL) return 1;
+    if (md->cv_stack_len > BLAKE3_MAX_DEPTH || md->chunk.buf_len > BLAKE3_BLOCK_LEN)
+    {
+        return 1;
+    }
+
+    while (inlen > 0)
+    {
+        size_t n;
+
+        /* the chunk is complete and more input follows, so it isn't the root */
+        if (blake3_chunk_len(&md->chunk) == BLAKE3_CHUNK_LEN)
+        {
+            uint32_t cv[8];
+            uint64_t total_chunks = md->chunk.chunk_counter + 1;
+
+            blake3_chunk_cv(&md->chunk, cv);
+            blake3_push_cv(md, cv, total_chunks);
+            blake3_chunk_init(&md->chunk, md->key, total_chunks);
+        }
+
+        /*
+           Whole chunks go to the SIMD kernel several at once. At least
+           one more byte has to follow them, since the very last chunk
+           of the input is the root and is finalized differently
+        */
+        if (blake3_hash_chunks != NULL && blake3_chunk_len(&md->chunk) == 0
+            && inlen > BLAKE3_SIMD_DEGREE * BLAKE3_CHUNK_LEN)
+        {
+            uint32_t cvs[BLAKE3_SIMD_DEGREE][8];
+            uint64_t counter = md->chunk.chunk_counter;
+            int k;
+
+            blake3_hash_chunks(md->key, in, counter, cvs);
+
+            for (k = 0; k < BLAKE3_SIMD_DEGREE; k++)
+            {
+                blake3_push_cv(md, cvs[k], counter + (uint64_t)k + 1);
+            }
+
+            blake3_chunk_init(&md->chunk, md->key, counter + BLAKE3_SIMD_DEGREE);
+            in += BLAKE3_SIMD_DEGREE * BLAKE3_CHUNK_LEN;
+            inlen -= BLAKE3_SIMD_DEGREE * BLAKE3_CHUNK_LEN;
+            continue;
+        }
+
+        n = MIN(inlen, BLAKE3_CHUNK_LEN - blake3_chunk_len(&md->chunk));
+        blake3_chunk_update(&md->chunk, in, n);
+        in += n;
+        inlen -= n;
+    }
+
+    return 0;
+}
+
+
+/**
+   Terminate the hash to get the digest. The state is left
+   untouched, so more data could be added afterwards
+   @param md  The hash state
+   @param out [out] The destination of the hash (32 bytes)
+   @return 0 if successful
+*/
+int blake3_final(const blake3_hasher *md, unsigned char *out)
+{
+    unsigned char block[BLAKE3_BLOCK_LEN];
+    uint32_t cv[8], words[16];
+    uint64_t counter;
+    uint8_t block_len, flags;
+    size_t remaining;
+    int i;
+
+    if (md == NULL) return 1;
+    if (out == NULL) return 1;
+    if (md->cv_stack_len > BLAKE3_MAX_DEPTH || md->chunk.buf_len > BLAKE3_BLOCK_LEN)
+    {
+        return 1;
+    }
+
+    /* the last chunk */
+    memcpy(cv, md->chunk.cv, 8 * sizeof(uint32_t));
+    memcpy(block, md->chunk.buf, BLAKE3_BLOCK_LEN);
+    block_len = md->chunk.buf_len;
+    counter = md->chunk.chunk_counter;
+    flags = (uint8_t)(md->chunk.flags | blake3_chunk_start_flag(&md->chunk) | CHUNK_END);
+
+    /* merge it with the subtrees in the stack from right to left */
+    for (remaining = md->cv_stack_len; remaining > 0; remaining--)
+    {
+        uint32_t right[8];
+
+        memcpy(right, cv, 8 * sizeof(uint32_t));
+        blake3_compress_cv(right, block, block_len, counter, flags);
+
+        for (i = 0; i < 8; i++)
+        {
+            STORE32L(md->cv_stack[remaining - 1][i], block + (4*i));
+            STORE32L(right[i], block + 32 + (4*i));
+        }
+
+        memcpy(cv, md->key, 8 * sizeof(uint32_t));
+        block_len = BLAKE3_BLOCK_LEN;
+        counter = 0;
+        flags = PARENT;
+    }
+
+    /* the root node */
+    blake3_compress(cv, block, block_len, 0, (uint8_t)(flags | ROOT), words);
+
+    for (i = 0; i < BLAKE3_OUT_LEN / 4; i++)
+    {
+        STORE32L(words[i], out + (4*i));
+    }
+
+    return 0;
+}
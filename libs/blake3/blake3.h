@@ -0,0 +1,50 @@
+#ifndef BLAKE3_H
+#define BLAKE3_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    BLAKE3 cryptographic hash function, the portable implementation
+    of the default hashing mode (no key, no key derivation) with
+    the 256-bit output.
+
+    The hash state is a plain structure without any pointers, so it
+    could be saved as is and restored later to continue hashing.
+*/
+
+#define BLAKE3_OUT_LEN 32
+#define BLAKE3_KEY_LEN 32
+#define BLAKE3_BLOCK_LEN 64
+#define BLAKE3_CHUNK_LEN 1024
+
+/* 2^54 chunks of 1KB is the maximum of the input length */
+#define BLAKE3_MAX_DEPTH 54
+
+/* state of the chunk that is being hashed now */
+typedef struct blake3_chunk_state_ {
+    uint32_t cv[8];
+    uint64_t chunk_counter;
+    unsigned char buf[BLAKE3_BLOCK_LEN];
+    uint8_t buf_len;
+    uint8_t blocks_compressed;
+    uint8_t flags;
+} blake3_chunk_state;
+
+/* state */
+typedef struct blake3_hasher_ {
+    uint32_t key[8];
+    blake3_chunk_state chunk;
+    uint8_t cv_stack_len;
+    /* chaining values of the subtrees that are not merged yet */
+    uint32_t cv_stack[BLAKE3_MAX_DEPTH][8];
+} blake3_hasher;
+
+int blake3_init(blake3_hasher*);
+int blake3_update(blake3_hasher*,const unsigned char*,size_t);
+int blake3_final(const blake3_hasher*,unsigned char*);
+
+/* name of the kernel selected for this CPU at startup */
+const char *blake3_kernel_name(void) __attribute__ ((pure));
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef BLAKE3_INTERNAL_H
+#define BLAKE3_INTERNAL_H
+
+/*
+    Declarations shared between the portable code and
+    the CPU specific kernels. Not a part of the public API.
+*/
+
+#include "blake3.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #define BLAKE3_X86 1
+#else
+    #define BLAKE3_X86 0
+#endif
+
+/* domain separation flags */
+#define CHUNK_START 1
+#define CHUNK_END   2
+#define PARENT      4
+#define ROOT        8
+
+/* the initialization vector, the same as of SHA-256 */
+extern const uint32_t blake3_IV[8];
+
+/* the message words used by every round */
+extern const uint8_t blake3_MSG_SCHEDULE[7][16];
+
+/* number of whole chunks hashed at once by a SIMD kernel */
+#define BLAKE3_SIMD_DEGREE 8
+
+/*
+   Hash BLAKE3_SIMD_DEGREE consecutive whole chunks numbered from
+   "counter" and write their chaining values one after another
+*/
+typedef void (*blake3_chunks_fn)(const uint32_t key[8], const unsigned char *in,
+                                 uint64_t counter, uint32_t out[BLAKE3_SIMD_DEGREE][8]);
+
+#if BLAKE3_X86
+int blake3_cpu_has_avx2(void);
+
+void blake3_hash_chunks_avx2(const uint32_t key[8], const unsigned char *in,
+                             uint64_t counter, uint32_t out[BLAKE3_SIMD_DEGREE][8]);
+#endif
+
+#endif
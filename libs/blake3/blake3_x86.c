@@ -0,0 +1,177 @@
+/*
+ * BLAKE3 kernels for x86-64
+ *
+ * blake3_hash_chunks_avx2() - 8 whole chunks at once, every 32-bit
+ *                             lane of a vector register carries the
+ *                             state of its own chunk
+ *
+ * The kernel is compiled with its own target attribute, so the
+ * library itself is built for the baseline ISA and the kernel is
+ * chosen at runtime by blake3_select_kernel().
+ */
+
+#include "blake3_internal.h"
+
+#if BLAKE3_X86
+
+#include <immintrin.h>
+
+/**
+   @return non-zero if the CPU and the OS support AVX2
+*/
+int blake3_cpu_has_avx2(void)
+{
+    __builtin_cpu_init();
+
+    return __builtin_cpu_supports("avx2");
+}
+
+#define ADD8(a, b)  _mm256_add_epi32((a), (b))
+#define XOR8(a, b)  _mm256_xor_si256((a), (b))
+
+/* 16 and 8 are whole bytes, so a shuffle is enough */
+#define ROT16(x)    _mm256_shuffle_epi8((x), rot16)
+#define ROT8(x)     _mm256_shuffle_epi8((x), rot8)
+#define ROT12(x)    _mm256_or_si256(_mm256_srli_epi32((x), 12), _mm256_slli_epi32((x), 20))
+#define ROT7(x)     _mm256_or_si256(_mm256_srli_epi32((x), 7), _mm256_slli_epi32((x), 25))
+
+#define G8(a, b, c, d, x, y) \
+    { \
+        v[a] = ADD8(ADD8(v[a], v[b]), (x)); v[d] = ROT16(XOR8(v[d], v[a])); \
+        v[c] = ADD8(v[c], v[d]);            v[b] = ROT12(XOR8(v[b], v[c])); \
+        v[a] = ADD8(ADD8(v[a], v[b]), (y)); v[d] = ROT8(XOR8(v[d], v[a]));  \
+        v[c] = ADD8(v[c], v[d]);            v[b] = ROT7(XOR8(v[b], v[c]));  \
+    }
+
+/* rows become columns: word i of v[j] goes to word j of v[i] */
+__attribute__((target("avx2")))
+static void transpose8(__m256i v[8])
+{
+    __m256i ab_0145 = _mm256_unpacklo_epi32(v[0], v[1]);
+    __m256i ab_2367 = _mm256_unpackhi_epi32(v[0], v[1]);
+    __m256i cd_0145 = _mm256_unpacklo_epi32(v[2], v[3]);
+    __m256i cd_2367 = _mm256_unpackhi_epi32(v[2], v[3]);
+    __m256i ef_0145 = _mm256_unpacklo_epi32(v[4], v[5]);
+    __m256i ef_2367 = _mm256_unpackhi_epi32(v[4], v[5]);
+    __m256i gh_0145 = _mm256_unpacklo_epi32(v[6], v[7]);
+    __m256i gh_2367 = _mm256_unpackhi_epi32(v[6], v[7]);
+
+    __m256i abcd_04 = _mm256_unpacklo_epi64(ab_0145, cd_0145);
+    __m256i abcd_15 = _mm256_unpackhi_epi64(ab_0145, cd_0145);
+    __m256i abcd_26 = _mm256_unpacklo_epi64(ab_2367, cd_2367);
+    __m256i abcd_37 = _mm256_unpackhi_epi64(ab_2367, cd_2367);
+    __m256i efgh_04 = _mm256_unpacklo_epi64(ef_0145, gh_0145);
+    __m256i efgh_15 = _mm256_unpackhi_epi64(ef_0145, gh_0145);
+    __m256i efgh_26 = _mm256_unpacklo_epi64(ef_2367, gh_2367);
+    __m256i efgh_37 = _mm256_unpackhi_epi64(ef_2367, gh_2367);
+
+    v[0] = _mm256_permute2x128_si256(abcd_04, efgh_04, 0x20);
+    v[1] = _mm256_permute2x128_si256(abcd_15, efgh_15, 0x20);
+    v[2] = _mm256_permute2x128_si256(abcd_26, efgh_26, 0x20);
+    v[3] = _mm256_permute2x128_si256(abcd_37, efgh_37, 0x20);
+    v[4] = _mm256_permute2x128_si256(abcd_04, efgh_04, 0x31);
+    v[5] = _mm256_permute2x128_si256(abcd_15, efgh_15, 0x31);
+    v[6] = _mm256_permute2x128_si256(abcd_26, efgh_26, 0x31);
+    v[7] = _mm256_permute2x128_si256(abcd_37, efgh_37, 0x31);
+}
+
+__attribute__((target("avx2")))
+void blake3_hash_chunks_avx2(const uint32_t key[8], const unsigned char *in,
+                             uint64_t counter, uint32_t out[BLAKE3_SIMD_DEGREE][8])
+{
+    const __m256i rot16 = _mm256_set_epi8(
+        13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2,
+        13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2);
+    const __m256i rot8 = _mm256_set_epi8(
+        12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1,
+        12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1);
+
+    __m256i h[8], v[16], m[16];
+    int i, j, block;
+
+    /* counters of the chunks, lane j is "counter + j" */
+    __m256i counter_lo = _mm256_set_epi32(
+        (int)(uint32_t)(counter + 7), (int)(uint32_t)(counter + 6),
+        (int)(uint32_t)(counter + 5), (int)(uint32_t)(counter + 4),
+        (int)(uint32_t)(counter + 3), (int)(uint32_t)(counter + 2),
+        (int)(uint32_t)(counter + 1), (int)(uint32_t)counter);
+    __m256i counter_hi = _mm256_set_epi32(
+        (int)(uint32_t)((counter + 7) >> 32), (int)(uint32_t)((counter + 6) >> 32),
+        (int)(uint32_t)((counter + 5) >> 32), (int)(uint32_t)((counter + 4) >> 32),
+        (int)(uint32_t)((counter + 3) >> 32), (int)(uint32_t)((counter + 2) >> 32),
+        (int)(uint32_t)((counter + 1) >> 32), (int)(uint32_t)(counter >> 32));
+
+    for (i = 0; i < 8; i++)
+    {
+        h[i] = _mm256_set1_epi32((int)key[i]);
+    }
+
+    for (block = 0; block < BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN; block++)
+    {
+        int flags = 0;
+
+        if (block == 0)
+        {
+            flags |= CHUNK_START;
+        }
+        if (block == BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN - 1)
+        {
+            flags |= CHUNK_END;
+        }
+
+        /* the words of the block of chunk j into lane j */
+        for (i = 0; i < 2; i++)
+        {
+            for (j = 0; j < 8; j++)
+            {
+                const unsigned char *p = in + (size_t)j * BLAKE3_CHUNK_LEN + (size_t)block * BLAKE3_BLOCK_LEN + 32 * (size_t)i;
+                m[8*i + j] = _mm256_loadu_si256((const __m256i *)(const void *)p);
+            }
+            transpose8(&m[8*i]);
+        }
+
+        for (i = 0; i < 8; i++)
+        {
+            v[i] = h[i];
+        }
+        v[8] = _mm256_set1_epi32((int)blake3_IV[0]);
+        v[9] = _mm256_set1_epi32((int)blake3_IV[1]);
+        v[10] = _mm256_set1_epi32((int)blake3_IV[2]);
+        v[11] = _mm256_set1_epi32((int)blake3_IV[3]);
+        v[12] = counter_lo;
+        v[13] = counter_hi;
+        v[14] = _mm256_set1_epi32(BLAKE3_BLOCK_LEN);
+        v[15] = _mm256_set1_epi32(flags);
+
+        for (i = 0; i < 7; i++)
+        {
+            const uint8_t *s = blake3_MSG_SCHEDULE[i];
+
+            /* columns */
+            G8(0, 4, 8, 12, m[s[0]], m[s[1]]);
+            G8(1, 5, 9, 13, m[s[2]], m[s[3]]);
+            G8(2, 6, 10, 14, m[s[4]], m[s[5]]);
+            G8(3, 7, 11, 15, m[s[6]], m[s[7]]);
+            /* diagonals */
+            G8(0, 5, 10, 15, m[s[8]], m[s[9]]);
+            G8(1, 6, 11, 12, m[s[10]], m[s[11]]);
+            G8(2, 7, 8, 13, m[s[12]], m[s[13]]);
+            G8(3, 4, 9, 14, m[s[14]], m[s[15]]);
+        }
+
+        for (i = 0; i < 8; i++)
+        {
+            h[i] = XOR8(v[i], v[i + 8]);
+        }
+    }
+
+    /* lane j of h[i] is word i of the chaining value of chunk j */
+    transpose8(h);
+
+    for (j = 0; j < 8; j++)
+    {
+        _mm256_storeu_si256((__m256i *)(void *)out[j], h[j]);
+    }
+}
+
+#endif /* BLAKE3_X86 */
@@ -9,11 +9,11 @@
  * Tom St Denis, tomstdenis@gmail.com, http://libtom.org
  */
 
-#include "sha512.h"
+#include "sha512_internal.h"
 #include <stdio.h>
 
 /* the K array */
-static const uint64_t K[80] =
+const uint64_t sha512_K[80] =
 {
     UINT64_C(0x428a2f98d728ae22), UINT64_C(0x7137449123ef65cd),
     UINT64_C(0xb5c0fbcfec4d3b2f), UINT64_C(0xe9b5dba58189dbbc),
@@ -71,14 +71,6 @@ static const uint64_t K[80] =
         (y)[6] = (unsigned char)(((x)>>8)&255); (y)[7] = (unsigned char)((x)&255); \
     }
 
-#define LOAD64H(x, y) \
-    { \
-        x = (((uint64_t)((y)[0] & 255))<<56)|(((uint64_t)((y)[1] & 255))<<48) | \
-        (((uint64_t)((y)[2] & 255))<<40)|(((uint64_t)((y)[3] & 255))<<32) | \
-        (((uint64_t)((y)[4] & 255))<<24)|(((uint64_t)((y)[5] & 255))<<16) | \
-        (((uint64_t)((y)[6] & 255))<<8)|(((uint64_t)((y)[7] & 255))); \
-    }
-
 #define Ch(x,y,z)       (z ^ (x & (y ^ z)))
 #define Maj(x,y,z)      (((x | y) & z) | (x & y))
 #define S(x, n)         ROR64c(x, n)
@@ -91,56 +83,149 @@ static const uint64_t K[80] =
 #define MIN(x, y) ( ((x)<(y))?(x):(y) )
 #endif
 
-/* compress 1024-bits */
-static int sha512_compress(SHA512_Context *md, const unsigned char *buf)
+/* compress "blocks" consecutive 1024-bit blocks, the portable kernel */
+static void sha512_compress_c(uint64_t state[8], const unsigned char *buf, size_t blocks)
 {
     uint64_t S[8], W[80], t0, t1;
     int i;
 
-    /* copy state into S */
-    for (i = 0; i < 8; i++)
+    for (; blocks > 0; blocks--, buf += 128)
     {
-        S[i] = md->state[i];
-    }
+        /* copy state into S */
+        for (i = 0; i < 8; i++)
+        {
+            S[i] = state[i];
+        }
 
-    /* copy the state into 1024-bits into W[0..15] */
-    for (i = 0; i < 16; i++)
-    {
-        LOAD64H(W[i], buf + (8*i));
+        /* copy the state into 1024-bits into W[0..15] */
+        for (i = 0; i < 16; i++)
+        {
+            LOAD64H(W[i], buf + (8*i));
+        }
+
+        /* fill W[16..79] */
+        for (i = 16; i < 80; i++)
+        {
+            W[i] = Gamma1(W[i - 2]) + W[i - 7] + Gamma0(W[i - 15]) + W[i - 16];
+        }
+
+        /* Compress */
+        #define RND(a,b,c,d,e,f,g,h,i) \
+            t0 = h + Sigma1(e) + Ch(e, f, g) + sha512_K[i] + W[i]; \
+            t1 = Sigma0(a) + Maj(a, b, c);\
+            d += t0; \
+            h  = t0 + t1;
+
+        for (i = 0; i < 80; i += 8)
+        {
+            RND(S[0],S[1],S[2],S[3],S[4],S[5],S[6],S[7],i+0);
+            RND(S[7],S[0],S[1],S[2],S[3],S[4],S[5],S[6],i+1);
+            RND(S[6],S[7],S[0],S[1],S[2],S[3],S[4],S[5],i+2);
+            RND(S[5],S[6],S[7],S[0],S[1],S[2],S[3],S[4],i+3);
+            RND(S[4],S[5],S[6],S[7],S[0],S[1],S[2],S[3],i+4);
+            RND(S[3],S[4],S[5],S[6],S[7],S[0],S[1],S[2],i+5);
+            RND(S[2],S[3],S[4],S[5],S[6],S[7],S[0],S[1],i+6);
+            RND(S[1],S[2],S[3],S[4],S[5],S[6],S[7],S[0],i+7);
+        }
+
+        #undef RND
+
+        /* feedback */
+        for (i = 0; i < 8; i++)
+        {
+            state[i] = state[i] + S[i];
+        }
     }
+}
+
+/* the kernel chosen for this CPU, the portable one until sha512_select_kernel() */
+static sha512_blocks_fn sha512_blocks = sha512_compress_c;
+
+#if SHA512_X86
+/**
+   Known-answer test of a kernel: the only block of "abc" from
+   FIPS 180-2 must give its well-known digest. A kernel that
+   the CPU claims to support but computes wrongly is not used
+   @param blocks   The kernel to test
+   @return 1 if the digest is right
+*/
+static int sha512_kernel_works(sha512_blocks_fn blocks)
+{
+    static const uint64_t expected[8] = {
+        UINT64_C(0xddaf35a193617aba), UINT64_C(0xcc417349ae204131),
+        UINT64_C(0x12e6fa4e89a97ea2), UINT64_C(0x0a9eeee64b55d39a),
+        UINT64_C(0x2192992a274fc1a8), UINT64_C(0x36ba3c23a3feebbd),
+        UINT64_C(0x454d4423643ce80e), UINT64_C(0x2a9ac94fa54ca49f)
+    };
+    SHA512_Context md;
+    unsigned char block[128] = { 'a', 'b', 'c', 0x80 };
+    int i;
 
-    /* fill W[16..79] */
-    for (i = 16; i < 80; i++)
+    /* the message is 24 bits long */
+    block[127] = 24;
+
+    sha512_init(&md);
+    blocks(md.state, block, 1);
+
+    for (i = 0; i < 8; i++)
     {
-        W[i] = Gamma1(W[i - 2]) + W[i - 7] + Gamma0(W[i - 15]) + W[i - 16];
+        if (md.state[i] != expected[i])
+        {
+            return 0;
+        }
     }
 
-    /* Compress */
-    #define RND(a,b,c,d,e,f,g,h,i) \
-        t0 = h + Sigma1(e) + Ch(e, f, g) + K[i] + W[i]; \
-        t1 = Sigma0(a) + Maj(a, b, c);\
-        d += t0; \
-        h  = t0 + t1;
+    return 1;
+}
+#endif
 
-    for (i = 0; i < 80; i += 8)
+/**
+   Pick the fastest kernel supported by the CPU the program
+   is running on. One static binary serves different hosts,
+   so the choice is made at startup rather than at compile time.
+   Every kernel has to pass a known-answer test before use,
+   otherwise the next one down to the portable one is taken
+*/
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((constructor))
+#endif
+static void sha512_select_kernel(void)
+{
+#if SHA512_X86
+    if (sha512_cpu_has_sha512ni() && sha512_kernel_works(sha512_blocks_sha512ni))
     {
-        RND(S[0],S[1],S[2],S[3],S[4],S[5],S[6],S[7],i+0);
-        RND(S[7],S[0],S[1],S[2],S[3],S[4],S[5],S[6],i+1);
-        RND(S[6],S[7],S[0],S[1],S[2],S[3],S[4],S[5],i+2);
-        RND(S[5],S[6],S[7],S[0],S[1],S[2],S[3],S[4],i+3);
-        RND(S[4],S[5],S[6],S[7],S[0],S[1],S[2],S[3],i+4);
-        RND(S[3],S[4],S[5],S[6],S[7],S[0],S[1],S[2],i+5);
-        RND(S[2],S[3],S[4],S[5],S[6],S[7],S[0],S[1],i+6);
-        RND(S[1],S[2],S[3],S[4],S[5],S[6],S[7],S[0],i+7);
+        sha512_blocks = sha512_blocks_sha512ni;
     }
+    else if (sha512_cpu_has_avx2() && sha512_kernel_works(sha512_blocks_avx2))
+    {
+        sha512_blocks = sha512_blocks_avx2;
+    }
+#endif
+}
 
-    #undef RND
-
-    /* feedback */
-    for (i = 0; i < 8; i++)
+/**
+   Name of the kernel in use
+   @return "sha512ni", "avx2" or "portable"
+*/
+const char *sha512_kernel_name(void)
+{
+#if SHA512_X86
+    if (sha512_blocks == sha512_blocks_sha512ni)
+    {
+        return "sha512ni";
+    }
+    if (sha512_blocks == sha512_blocks_avx2)
     {
-        md->state[i] = md->state[i] + S[i];
+        return "avx2";
     }
+#endif
+    return "portable";
+}
+
+/* compress 1024-bits */
+static int sha512_compress(SHA512_Context *md, const unsigned char *buf)
+{
+    sha512_blocks(md->state, buf, 1);
 
     return 0;
 }
@@ -192,13 +277,12 @@ int sha512_update (SHA512_Context * md, const unsigned char *in, size_t inlen)
     {
         if (md->curlen == 0 && inlen >= 128)
         {
-            if ((err = sha512_compress (md,in)) != 0)
-            {
-                return err;
-            }
-            md->length += 128 * 8;
-            in             += 128;
-            inlen          -= 128;
+            /* all full blocks go to the kernel at once */
+            n = inlen / 128;
+            sha512_blocks(md->state, in, n);
+            md->length += n * 128 * 8;
+            in             += n * 128;
+            inlen          -= n * 128;
         }
         else
         {
@@ -64,4 +64,13 @@ int sha512_init(SHA512_Context*);
 int sha512_final(SHA512_Context*,unsigned char*);
 int sha512_update(SHA512_Context*,const unsigned char*,size_t);
 
+/* name of the kernel selected for this CPU at startup */
+const char *sha512_kernel_name(void) __attribute__ ((pure));
+
+/* multi-buffer: several independent streams at once */
+#define SHA512_MB_LANES_MAX 8
+
+int sha512_mb_lanes(void);
+int sha512_update_mb(SHA512_Context**,const unsigned char**,const size_t*,size_t);
+
 #endif
@@ -0,0 +1,47 @@
+#ifndef SHA512_INTERNAL_H
+#define SHA512_INTERNAL_H
+
+/*
+    Declarations shared between the portable code and
+    the CPU specific kernels. Not a part of the public API.
+*/
+
+#include "sha512.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #define SHA512_X86 1
+#else
+    #define SHA512_X86 0
+#endif
+
+/* The SHA512 instruction extension needs GCC 14 or Clang 18 */
+#if SHA512_X86 && ((!defined(__clang__) && __GNUC__ >= 14) || (defined(__clang__) && __clang_major__ >= 18))
+    #define SHA512_X86_SHA512NI 1
+#else
+    #define SHA512_X86_SHA512NI 0
+#endif
+
+/* the K array */
+extern const uint64_t sha512_K[80];
+
+#define LOAD64H(x, y) \
+    { \
+        x = (((uint64_t)((y)[0] & 255))<<56)|(((uint64_t)((y)[1] & 255))<<48) | \
+        (((uint64_t)((y)[2] & 255))<<40)|(((uint64_t)((y)[3] & 255))<<32) | \
+        (((uint64_t)((y)[4] & 255))<<24)|(((uint64_t)((y)[5] & 255))<<16) | \
+        (((uint64_t)((y)[6] & 255))<<8)|(((uint64_t)((y)[7] & 255))); \
+    }
+
+/* compress "blocks" consecutive 1024-bit blocks into the state */
+typedef void (*sha512_blocks_fn)(uint64_t state[8], const unsigned char *buf, size_t blocks);
+
+#if SHA512_X86
+int sha512_cpu_has_avx2(void);
+int sha512_cpu_has_avx512(void);
+int sha512_cpu_has_sha512ni(void) __attribute__ ((const));
+
+void sha512_blocks_avx2(uint64_t state[8], const unsigned char *buf, size_t blocks);
+void sha512_blocks_sha512ni(uint64_t state[8], const unsigned char *buf, size_t blocks);
+#endif
+
+#endif
@@ -0,0 +1,354 @@
+/*
+ * Multi-buffer SHA-512
+ *
+ * Several independent streams are hashed at once: every lane of a
+ * vector register carries the state of its own stream, so one pass
+ * of the compression loop processes one 128-byte block of each stream.
+ * AVX-512 hashes 8 streams per pass, AVX2 hashes 4. The kernel is
+ * selected at runtime, the portable code is used everywhere else.
+ *
+ * The result for every stream is bit-exact with the one produced by
+ * sha512_update() applied to that stream alone.
+ */
+
+#include "sha512_internal.h"
+#include <string.h>
+
+#if SHA512_X86
+
+#include <immintrin.h>
+
+/*
+ * 4 lanes with AVX2
+ */
+
+#define ROR4(x, n)  _mm256_or_si256(_mm256_srli_epi64((x), (n)), _mm256_slli_epi64((x), 64 - (n)))
+#define SHR4(x, n)  _mm256_srli_epi64((x), (n))
+#define XOR4(a, b)  _mm256_xor_si256((a), (b))
+#define ADD4(a, b)  _mm256_add_epi64((a), (b))
+#define CH4(x,y,z)  XOR4(z, _mm256_and_si256(x, XOR4(y, z)))
+#define MAJ4(x,y,z) _mm256_or_si256(_mm256_and_si256(_mm256_or_si256(x, y), z), _mm256_and_si256(x, y))
+#define SIGMA0_4(x) XOR4(XOR4(ROR4(x, 28), ROR4(x, 34)), ROR4(x, 39))
+#define SIGMA1_4(x) XOR4(XOR4(ROR4(x, 14), ROR4(x, 18)), ROR4(x, 41))
+#define GAMMA0_4(x) XOR4(XOR4(ROR4(x, 1), ROR4(x, 8)), SHR4(x, 7))
+#define GAMMA1_4(x) XOR4(XOR4(ROR4(x, 19), ROR4(x, 61)), SHR4(x, 6))
+
+/* compress "blocks" 1024-bit blocks of 4 streams at once */
+__attribute__((target("avx2")))
+static void sha512_compress_x4(SHA512_Context *md[4], const unsigned char *buf[4], size_t blocks)
+{
+    __m256i S[8], H[8], W[80], t0, t1;
+    uint64_t w[4];
+    int i, j;
+
+    /* transpose the states: lane j of S[i] is md[j]->state[i] */
+    for (i = 0; i < 8; i++)
+    {
+        H[i] = _mm256_set_epi64x((long long)md[3]->state[i], (long long)md[2]->state[i],
+                                 (long long)md[1]->state[i], (long long)md[0]->state[i]);
+    }
+
+    while (blocks-- > 0)
+    {
+        for (i = 0; i < 16; i++)
+        {
+            for (j = 0; j < 4; j++)
+            {
+                LOAD64H(w[j], buf[j] + (8*i));
+            }
+            W[i] = _mm256_set_epi64x((long long)w[3], (long long)w[2], (long long)w[1], (long long)w[0]);
+        }
+
+        for (i = 16; i < 80; i++)
+        {
+            W[i] = ADD4(ADD4(GAMMA1_4(W[i - 2]), W[i - 7]), ADD4(GAMMA0_4(W[i - 15]), W[i - 16]));
+        }
+
+        for (i = 0; i < 8; i++)
+        {
+            S[i] = H[i];
+        }
+
+        for (i = 0; i < 80; i++)
+        {
+            t0 = ADD4(ADD4(ADD4(S[7], SIGMA1_4(S[4])), ADD4(CH4(S[4], S[5], S[6]), _mm256_set1_epi64x((long long)sha512_K[i]))), W[i]);
+            t1 = ADD4(SIGMA0_4(S[0]), MAJ4(S[0], S[1], S[2]));
+            S[7] = S[6];
+            S[6] = S[5];
+            S[5] = S[4];
+            S[4] = ADD4(S[3], t0);
+            S[3] = S[2];
+            S[2] = S[1];
+            S[1] = S[0];
+            S[0] = ADD4(t0, t1);
+        }
+
+        for (i = 0; i < 8; i++)
+        {
+            H[i] = ADD4(H[i], S[i]);
+        }
+
+        for (j = 0; j < 4; j++)
+        {
+            buf[j] += 128;
+        }
+    }
+
+    for (i = 0; i < 8; i++)
+    {
+        uint64_t out[4];
+        _mm256_storeu_si256((__m256i *)out, H[i]);
+        for (j = 0; j < 4; j++)
+        {
+            md[j]->state[i] = out[j];
+        }
+    }
+}
+
+/*
+ * 8 lanes with AVX-512
+ */
+
+#if defined(__GNUC__) && !defined(__clang__)
+/* GCC headers initialise the "undefined" vectors by themselves (__Y = __Y) */
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#define ROR8(x, n)  _mm512_ror_epi64((x), (n))
+#define SHR8(x, n)  _mm512_srli_epi64((x), (n))
+#define ADD8(a, b)  _mm512_add_epi64((a), (b))
+#define XOR3_8(a, b, c) _mm512_ternarylogic_epi64((a), (b), (c), 0x96)
+#define CH8(x,y,z)  _mm512_ternarylogic_epi64((x), (y), (z), 0xCA)
+#define MAJ8(x,y,z) _mm512_ternarylogic_epi64((x), (y), (z), 0xE8)
+#define SIGMA0_8(x) XOR3_8(ROR8(x, 28), ROR8(x, 34), ROR8(x, 39))
+#define SIGMA1_8(x) XOR3_8(ROR8(x, 14), ROR8(x, 18), ROR8(x, 41))
+#define GAMMA0_8(x) XOR3_8(ROR8(x, 1), ROR8(x, 8), SHR8(x, 7))
+#define GAMMA1_8(x) XOR3_8(ROR8(x, 19), ROR8(x, 61), SHR8(x, 6))
+
+/* compress "blocks" 1024-bit blocks of 8 streams at once */
+__attribute__((target("avx512f")))
+static void sha512_compress_x8(SHA512_Context *md[8], const unsigned char *buf[8], size_t blocks)
+{
+    __m512i S[8], H[8], W[80], t0, t1;
+    uint64_t w[8];
+    int i, j;
+
+    for (i = 0; i < 8; i++)
+    {
+        for (j = 0; j < 8; j++)
+        {
+            w[j] = md[j]->state[i];
+        }
+        H[i] = _mm512_loadu_si512((const void *)w);
+    }
+
+    while (blocks-- > 0)
+    {
+        for (i = 0; i < 16; i++)
+        {
+            for (j = 0; j < 8; j++)
+            {
+                LOAD64H(w[j], buf[j] + (8*i));
+            }
+            W[i] = _mm512_loadu_si512((const void *)w);
+        }
+
+        for (i = 16; i < 80; i++)
+        {
+            W[i] = ADD8(ADD8(GAMMA1_8(W[i - 2]), W[i - 7]), ADD8(GAMMA0_8(W[i - 15]), W[i - 16]));
+        }
+
+        for (i = 0; i < 8; i++)
+        {
+            S[i] = H[i];
+        }
+
+        for (i = 0; i < 80; i++)
+        {
+            t0 = ADD8(ADD8(ADD8(S[7], SIGMA1_8(S[4])), ADD8(CH8(S[4], S[5], S[6]), _mm512_set1_epi64((long long)sha512_K[i]))), W[i]);
+            t1 = ADD8(SIGMA0_8(S[0]), MAJ8(S[0], S[1], S[2]));
+            S[7] = S[6];
+            S[6] = S[5];
+            S[5] = S[4];
+            S[4] = ADD8(S[3], t0);
+            S[3] = S[2];
+            S[2] = S[1];
+            S[1] = S[0];
+            S[0] = ADD8(t0, t1);
+        }
+
+        for (i = 0; i < 8; i++)
+        {
+            H[i] = ADD8(H[i], S[i]);
+        }
+
+        for (j = 0; j < 8; j++)
+        {
+            buf[j] += 128;
+        }
+    }
+
+    for (i = 0; i < 8; i++)
+    {
+        _mm512_storeu_si512((void *)w, H[i]);
+        for (j = 0; j < 8; j++)
+        {
+            md[j]->state[i] = w[j];
+        }
+    }
+}
+
+#endif /* SHA512_X86 */
+
+/**
+   Number of streams the multi-buffer kernel hashes at once on this CPU
+   @return 8 with AVX-512, 4 with AVX2, 1 if only the portable code is available
+*/
+int sha512_mb_lanes(void)
+{
+#if SHA512_X86
+    static int lanes = 0;
+
+    if (lanes == 0)
+    {
+        if (sha512_cpu_has_avx512())
+        {
+            lanes = 8;
+        }
+        else if (sha512_cpu_has_avx2())
+        {
+            lanes = 4;
+        }
+        else
+        {
+            lanes = 1;
+        }
+    }
+
+    return lanes;
+#else
+    return 1;
+#endif
+}
+
+/**
+   Process several independent streams though the hash
+   @param md     Array of "count" hash states
+   @param in     Array of "count" pointers to the data of each stream
+   @param inlen  Array of "count" lengths of the data (octets)
+   @param count  Number of streams
+   @return 0 if successful
+*/
+int sha512_update_mb(SHA512_Context **md, const unsigned char **in, const size_t *inlen, size_t count)
+{
+    const unsigned char *ptr[SHA512_MB_LANES_MAX];
+    size_t left[SHA512_MB_LANES_MAX];
+    size_t i;
+    int err;
+
+    if (md == NULL || in == NULL || inlen == NULL) return 1;
+
+    for (i = 0; i < count; i += SHA512_MB_LANES_MAX)
+    {
+        size_t n = count - i < SHA512_MB_LANES_MAX ? count - i : SHA512_MB_LANES_MAX;
+        size_t j;
+
+        /* align every stream to a block boundary */
+        for (j = 0; j < n; j++)
+        {
+            if (md[i + j] == NULL || in[i + j] == NULL) return 1;
+
+            ptr[j] = in[i + j];
+            left[j] = inlen[i + j];
+
+            if (md[i + j]->curlen > 0)
+            {
+                size_t fill = 128 - md[i + j]->curlen;
+
+                if (fill > left[j])
+                {
+                    fill = left[j];
+                }
+                if ((err = sha512_update(md[i + j], ptr[j], fill)) != 0)
+                {
+                    return err;
+                }
+                ptr[j] += fill;
+                left[j] -= fill;
+            }
+        }
+
+#if SHA512_X86
+        int lanes = sha512_mb_lanes();
+
+        /* full blocks of the streams that still have them go in lockstep */
+        while (lanes > 1)
+        {
+            SHA512_Context *lane_md[SHA512_MB_LANES_MAX];
+            const unsigned char *lane_in[SHA512_MB_LANES_MAX];
+            size_t lane_of[SHA512_MB_LANES_MAX];
+            SHA512_Context idle[SHA512_MB_LANES_MAX];
+            size_t active = 0, blocks = 0, k;
+
+            for (j = 0; j < n && active < (size_t)lanes; j++)
+            {
+                if (left[j] >= 128)
+                {
+                    size_t b = left[j] / 128;
+
+                    if (active == 0 || b < blocks)
+                    {
+                        blocks = b;
+                    }
+                    lane_of[active] = j;
+                    lane_md[active] = md[i + j];
+                    lane_in[active] = ptr[j];
+                    active++;
+                }
+            }
+
+            /* a single stream is faster with the scalar kernel */
+            if (active < 2)
+            {
+                break;
+            }
+
+            /* unused lanes run over a copy of the first stream */
+            for (k = active; k < (size_t)lanes; k++)
+            {
+                memcpy(&idle[k], lane_md[0], sizeof(SHA512_Context));
+                lane_md[k] = &idle[k];
+                lane_in[k] = lane_in[0];
+            }
+
+            if (lanes == 8)
+            {
+                sha512_compress_x8(lane_md, lane_in, blocks);
+            }
+            else
+            {
+                sha512_compress_x4(lane_md, lane_in, blocks);
+            }
+
+            for (k = 0; k < active; k++)
+            {
+                j = lane_of[k];
+                md[i + j]->length += blocks * 128 * 8;
+                ptr[j] += blocks * 128;
+                left[j] -= blocks * 128;
+            }
+        }
+#endif
+
+        /* the tails */
+        for (j = 0; j < n; j++)
+        {
+            if (left[j] > 0 && (err = sha512_update(md[i + j], ptr[j], left[j])) != 0)
+            {
+                return err;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,268 @@
+/*
+ * Single-stream SHA-512 kernels for x86-64
+ *
+ * sha512_blocks_avx2()     - the message schedule is calculated with
+ *                            AVX2 for two blocks at once (one block per
+ *                            128-bit lane), the rounds use BMI2 rotates
+ * sha512_blocks_sha512ni() - the SHA512 instruction extension
+ *                            (VSHA512RNDS2, VSHA512MSG1, VSHA512MSG2)
+ *
+ * Every kernel is compiled with its own target attribute, so the
+ * library itself is built for the baseline ISA and the kernel is
+ * chosen at runtime by sha512_select_kernel().
+ */
+
+#include "sha512_internal.h"
+
+#if SHA512_X86
+
+#include <immintrin.h>
+#include <cpuid.h>
+
+/**
+   @return non-zero if the CPU and the OS support AVX2 and BMI2
+*/
+int sha512_cpu_has_avx2(void)
+{
+    __builtin_cpu_init();
+
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2");
+}
+
+/**
+   @return non-zero if the CPU and the OS support AVX-512F
+*/
+int sha512_cpu_has_avx512(void)
+{
+    __builtin_cpu_init();
+
+    return __builtin_cpu_supports("avx512f");
+}
+
+/**
+   @return non-zero if the CPU supports the SHA512 instruction extension
+   and the kernel for it has been compiled in
+*/
+int sha512_cpu_has_sha512ni(void)
+{
+#if SHA512_X86_SHA512NI
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+    /* CPUID.(EAX=07H, ECX=1):EAX[bit 0] */
+    if (!__get_cpuid_count(7, 1, &eax, &ebx, &ecx, &edx))
+    {
+        return 0;
+    }
+
+    /* the instructions operate on YMM registers */
+    return (eax & 1) && sha512_cpu_has_avx2();
+#else
+    return 0;
+#endif
+}
+
+/*
+ * AVX2 + BMI2
+ */
+
+#define ROR64(x, n)     (((x) >> (n)) | ((x) << (64 - (n))))
+#define Ch(x,y,z)       (z ^ (x & (y ^ z)))
+#define Maj(x,y,z)      (((x | y) & z) | (x & y))
+#define Sigma0(x)       (ROR64(x, 28) ^ ROR64(x, 34) ^ ROR64(x, 39))
+#define Sigma1(x)       (ROR64(x, 14) ^ ROR64(x, 18) ^ ROR64(x, 41))
+
+#define VROR(x, n)      _mm256_or_si256(_mm256_srli_epi64((x), (n)), _mm256_slli_epi64((x), 64 - (n)))
+#define VGamma0(x)      _mm256_xor_si256(_mm256_xor_si256(VROR(x, 1), VROR(x, 8)), _mm256_srli_epi64((x), 7))
+#define VGamma1(x)      _mm256_xor_si256(_mm256_xor_si256(VROR(x, 19), VROR(x, 61)), _mm256_srli_epi64((x), 6))
+
+/* 80 rounds of one block with precalculated W[i] + K[i] */
+__attribute__((target("avx2,bmi2")))
+static void sha512_rounds(uint64_t state[8], const uint64_t *wk)
+{
+    uint64_t S[8], t0, t1;
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        S[i] = state[i];
+    }
+
+    #define RND(a,b,c,d,e,f,g,h,i) \
+        t0 = h + Sigma1(e) + Ch(e, f, g) + wk[i]; \
+        t1 = Sigma0(a) + Maj(a, b, c);\
+        d += t0; \
+        h  = t0 + t1;
+
+    for (i = 0; i < 80; i += 8)
+    {
+        RND(S[0],S[1],S[2],S[3],S[4],S[5],S[6],S[7],i+0);
+        RND(S[7],S[0],S[1],S[2],S[3],S[4],S[5],S[6],i+1);
+        RND(S[6],S[7],S[0],S[1],S[2],S[3],S[4],S[5],i+2);
+        RND(S[5],S[6],S[7],S[0],S[1],S[2],S[3],S[4],i+3);
+        RND(S[4],S[5],S[6],S[7],S[0],S[1],S[2],S[3],i+4);
+        RND(S[3],S[4],S[5],S[6],S[7],S[0],S[1],S[2],i+5);
+        RND(S[2],S[3],S[4],S[5],S[6],S[7],S[0],S[1],i+6);
+        RND(S[1],S[2],S[3],S[4],S[5],S[6],S[7],S[0],i+7);
+    }
+
+    #undef RND
+
+    for (i = 0; i < 8; i++)
+    {
+        state[i] = state[i] + S[i];
+    }
+}
+
+__attribute__((target("avx2,bmi2")))
+void sha512_blocks_avx2(uint64_t state[8], const unsigned char *buf, size_t blocks)
+{
+    /* W[i] + K[i] of the first block in wk[0], of the second one in wk[1] */
+    uint64_t wk[2][80] __attribute__((aligned(32)));
+    __m256i X[8];
+    int i;
+
+    /* swap bytes of every 64-bit word */
+    const __m256i bswap = _mm256_set_epi8(
+        8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+        8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+
+    while (blocks > 0)
+    {
+        /* the last odd block is scheduled twice, the copy is thrown away */
+        size_t pair = blocks >= 2 ? 2 : 1;
+        const unsigned char *second = pair == 2 ? buf + 128 : buf;
+
+        /* W[0..15]: words 2i and 2i+1 of both blocks in X[i] */
+        for (i = 0; i < 8; i++)
+        {
+            __m128i lo = _mm_loadu_si128((const __m128i *)(const void *)(buf + 16*i));
+            __m128i hi = _mm_loadu_si128((const __m128i *)(const void *)(second + 16*i));
+            __m256i k = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)(sha512_K + 2*i)));
+
+            X[i] = _mm256_shuffle_epi8(_mm256_set_m128i(hi, lo), bswap);
+
+            __m256i sum = _mm256_add_epi64(X[i], k);
+            _mm_store_si128((__m128i *)(void *)(wk[0] + 2*i), _mm256_castsi256_si128(sum));
+            _mm_store_si128((__m128i *)(void *)(wk[1] + 2*i), _mm256_extracti128_si256(sum, 1));
+        }
+
+        /* W[16..79], two words of both blocks per step */
+        for (i = 16; i < 80; i += 2)
+        {
+            int j = (i / 2) & 7;
+
+            /* W[i-15], W[i-14] */
+            __m256i w15 = _mm256_alignr_epi8(X[(j + 1) & 7], X[j], 8);
+            /* W[i-7], W[i-6] */
+            __m256i w7 = _mm256_alignr_epi8(X[(j + 5) & 7], X[(j + 4) & 7], 8);
+
+            X[j] = _mm256_add_epi64(
+                _mm256_add_epi64(X[j], VGamma0(w15)),
+                _mm256_add_epi64(w7, VGamma1(X[(j + 7) & 7])));
+
+            __m256i k = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(const void *)(sha512_K + i)));
+            __m256i sum = _mm256_add_epi64(X[j], k);
+            _mm_store_si128((__m128i *)(void *)(wk[0] + i), _mm256_castsi256_si128(sum));
+            _mm_store_si128((__m128i *)(void *)(wk[1] + i), _mm256_extracti128_si256(sum, 1));
+        }
+
+        sha512_rounds(state, wk[0]);
+
+        if (pair == 2)
+        {
+            sha512_rounds(state, wk[1]);
+        }
+
+        buf += 128 * pair;
+        blocks -= pair;
+    }
+}
+
+/*
+ * SHA512 instruction extension
+ */
+
+#if SHA512_X86_SHA512NI
+
+__attribute__((target("avx2,sha512")))
+void sha512_blocks_sha512ni(uint64_t state[8], const unsigned char *buf, size_t blocks)
+{
+    const __m256i bswap = _mm256_set_epi8(
+        8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+        8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+
+    /* state[0..3] = A B C D, state[4..7] = E F G H */
+    __m256i abcd = _mm256_permute4x64_epi64(_mm256_loadu_si256((const __m256i *)(const void *)state), 0x1B);
+    __m256i efgh = _mm256_permute4x64_epi64(_mm256_loadu_si256((const __m256i *)(const void *)(state + 4)), 0x1B);
+
+    /* the instructions keep the state as {A B E F} and {C D G H} */
+    __m256i abef = _mm256_permute2x128_si256(efgh, abcd, 0x31);
+    __m256i cdgh = _mm256_permute2x128_si256(efgh, abcd, 0x20);
+
+    while (blocks-- > 0)
+    {
+        __m256i abef_save = abef;
+        __m256i cdgh_save = cdgh;
+        __m256i W[4], wk, tmp;
+        int i;
+
+        for (i = 0; i < 80; i += 4)
+        {
+            __m256i *w = &W[(i / 4) & 3];
+
+            if (i < 16)
+            {
+                *w = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(const void *)(buf + 8*i)), bswap);
+            }
+            else
+            {
+                /* W[i-16..i-13] + Gamma0(W[i-15..i-12]) */
+                __m256i msg = _mm256_sha512msg1_epi64(*w, _mm256_castsi256_si128(W[(i / 4 + 1) & 3]));
+
+                /* + W[i-7..i-4] */
+                __m256i w7 = _mm256_permute4x64_epi64(
+                    _mm256_blend_epi32(W[(i / 4 + 2) & 3], W[(i / 4 + 3) & 3], 0x03), 0x39);
+                msg = _mm256_add_epi64(msg, w7);
+
+                /* + Gamma1(W[i-2..i+1]) */
+                *w = _mm256_sha512msg2_epi64(msg, W[(i / 4 + 3) & 3]);
+            }
+
+            wk = _mm256_add_epi64(*w, _mm256_loadu_si256((const __m256i *)(const void *)(sha512_K + i)));
+
+            tmp = _mm256_sha512rnds2_epi64(cdgh, abef, _mm256_castsi256_si128(wk));
+            cdgh = abef;
+            abef = tmp;
+
+            tmp = _mm256_sha512rnds2_epi64(cdgh, abef, _mm256_extracti128_si256(wk, 1));
+            cdgh = abef;
+            abef = tmp;
+        }
+
+        abef = _mm256_add_epi64(abef, abef_save);
+        cdgh = _mm256_add_epi64(cdgh, cdgh_save);
+
+        buf += 128;
+    }
+
+    /* back to A B C D E F G H */
+    abcd = _mm256_permute4x64_epi64(_mm256_permute2x128_si256(cdgh, abef, 0x31), 0x1B);
+    efgh = _mm256_permute4x64_epi64(_mm256_permute2x128_si256(cdgh, abef, 0x20), 0x1B);
+
+    _mm256_storeu_si256((__m256i *)(void *)state, abcd);
+    _mm256_storeu_si256((__m256i *)(void *)(state + 4), efgh);
+}
+
+#else
+
+/* never selected: the compiler knows nothing about the extension */
+void sha512_blocks_sha512ni(uint64_t state[8], const unsigned char *buf, size_t blocks)
+{
+    (void)state;
+    (void)buf;
+    (void)blocks;
+}
+
+#endif /* SHA512_X86_SHA512NI */
+
+#endif /* SHA512_X86 */
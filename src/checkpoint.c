@@ -0,0 +1,70 @@
+#include "precizer.h"
+
+/**
+ *
+ * @file checkpoint.c
+ * @brief When to save the state of a file being hashed
+ * @details With --checkpoint-every the state of a huge file is
+ * saved against the DB from time to time, not only on Ctrl+C.
+ * So hashing could be resumed from the last checkpoint even
+ * after the program has been killed or the host has lost power.
+ *
+ */
+
+/**
+ *
+ * Remember the moment hashing of a file has
+ * been started or its state has been saved
+ *
+ */
+void checkpoint_start
+(
+	Checkpoint *checkpoint,
+	sqlite3_int64 offset
+){
+	checkpoint->offset = offset;
+
+	if(config->checkpoint_seconds > 0)
+	{
+		clock_gettime(CLOCK_MONOTONIC,&checkpoint->time);
+	}
+}
+
+/**
+ *
+ * True if the state of a file hashed up to the offset
+ * should be saved against the DB right now. The moment
+ * is remembered then as the start of the next interval
+ *
+ */
+bool checkpoint_is_due
+(
+	Checkpoint *checkpoint,
+	sqlite3_int64 offset
+){
+	bool due = false;
+
+	if(config->checkpoint_bytes > 0
+		&& offset - checkpoint->offset >= config->checkpoint_bytes)
+	{
+		due = true;
+
+	} else if(config->checkpoint_seconds > 0)
+	{
+		struct timespec now;
+
+		clock_gettime(CLOCK_MONOTONIC,&now);
+
+		if(now.tv_sec - checkpoint->time.tv_sec >= config->checkpoint_seconds)
+		{
+			due = true;
+		}
+	}
+
+	if(due == true)
+	{
+		checkpoint_start(checkpoint,offset);
+	}
+
+	return(due);
+}
@@ -0,0 +1,121 @@
+#include "precizer.h"
+
+/**
+ *
+ * @file db_bulk_load.c
+ * @brief The first run against a brand new database
+ * @details Nothing has been saved against a brand new database yet,
+ * so every file is new and looking it up against the database
+ * would only miss. Files are appended to the table 'files' without
+ * any lookup and without an index to be kept up to date on every
+ * insert. The index is built at once after loading, also when the
+ * scan has been interrupted, so the next run with --update resumes
+ * against an indexed table. If the program has been killed before
+ * that, the index is built at the start of the next run.
+ *
+ */
+
+/// The only index of the table 'files'. Files are looked up
+/// by the path they have been found in and the relative path
+static const char *index_sql = "CREATE UNIQUE INDEX IF NOT EXISTS full_path ON files (path_prefix_index, relative_path);";
+
+/**
+ *
+ * Build the index of the table 'files' if it doesn't exist yet
+ *
+ */
+static Return create_index(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	int rc = sqlite3_exec(config->db, index_sql, NULL, NULL, NULL);
+	if(rc!= SQLITE_OK ){
+		slog(false,"Can't execute %s (%i): %s\n", index_sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Decide whether files are loaded in bulk. It is possible
+ * only against a brand new database. A path passed twice is
+ * traversed only once, so the same file could never be found
+ * twice. Otherwise the index is made sure to exist. Nothing is
+ * loaded or indexed with --dry-run
+ *
+ */
+Return db_bulk_load_begin(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	// Don't do anything
+	if(config->compare == true || config->dry_run == true)
+	{
+		return(status);
+	}
+
+	bool bulk_load = config->db_already_exists == false;
+
+	if(bulk_load == false)
+	{
+		status = create_index();
+		return(status);
+	}
+
+	config->bulk_load = true;
+
+	slog(true,"The database is brand new. Files will be loaded without lookups and indexed after loading\n");
+
+	return(status);
+}
+
+/**
+ *
+ * Build the index after files have been loaded in bulk.
+ * The sorting of the index is shared between as many
+ * threads as files have been hashed with
+ *
+ */
+Return db_bulk_load_end(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	// Don't do anything
+	if(config->bulk_load == false)
+	{
+		return(status);
+	}
+
+	config->bulk_load = false;
+
+	if(config->threads > 0)
+	{
+		char threads_sql[64];
+
+		snprintf(threads_sql,sizeof(threads_sql),"PRAGMA threads = %u;",config->threads);
+
+		int rc = sqlite3_exec(config->db, threads_sql, NULL, NULL, NULL);
+		if(rc!= SQLITE_OK ){
+			slog(false,"Can't execute %s (%i): %s\n", threads_sql, rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+			return(status);
+		}
+	}
+
+	long long int started = cur_time_ms();
+
+	if(SUCCESS == (status = create_index()))
+	{
+		slog(true,"The index has been built in %lld ms\n",cur_time_ms() - started);
+	}
+
+	return(status);
+}
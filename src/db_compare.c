@@ -1,4 +1,466 @@
 #include "precizer.h"
+#include <pthread.h>
+
+/**
+ *
+ * True if the column exists in the table 'files'
+ * of the attached database
+ *
+ */
+static Return db_compare_column_exists
+(
+	const char *schema,
+	const char *column,
+	bool *exists
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	sqlite3_stmt *select_stmt = NULL;
+	int rc = 0;
+
+	*exists = false;
+
+	const char *select_sql = "SELECT COUNT(*) FROM pragma_table_info('files',?1) WHERE name = ?2;";
+
+	rc = sqlite3_prepare_v2(config->db, select_sql, -1, &select_stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare select statement %s (%i): %s\n", select_sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	rc = sqlite3_bind_text(select_stmt, 1, schema, (int)strlen(schema), NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Error binding value in select (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	rc = sqlite3_bind_text(select_stmt, 2, column, (int)strlen(column), NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Error binding value in select (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	while(SQLITE_ROW == (rc = sqlite3_step(select_stmt)))
+	{
+		if(sqlite3_column_int64(select_stmt,0) > 0)
+		{
+			*exists = true;
+		}
+	}
+	if(SQLITE_DONE != rc) {
+		slog(false,"Select statement didn't finish with DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+	sqlite3_finalize(select_stmt);
+
+	return(status);
+}
+
+/**
+ *
+ * Databases created by previous versions have no column
+ * with the hash algorithm and all their checksums are SHA512.
+ * They have no column with the path of a file either and all
+ * their files belong to the only path. A temporary view with
+ * both columns is made for all cases, so the attached database
+ * itself is never changed
+ *
+ */
+static Return db_compare_files_view
+(
+	const char *schema
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	int rc = 0;
+
+	bool algorithm_column_exists = false;
+	bool path_prefix_index_column_exists = false;
+
+	if(SUCCESS == status)
+	{
+		status = db_compare_column_exists(schema,"algorithm",&algorithm_column_exists);
+	}
+
+	if(SUCCESS == status)
+	{
+		status = db_compare_column_exists(schema,"path_prefix_index",&path_prefix_index_column_exists);
+	}
+
+	if(SUCCESS != status)
+	{
+		return(status);
+	}
+
+	const char *algorithm = algorithm_column_exists == true ? "algorithm" : "1 AS algorithm";
+
+	char path_prefix_index[128];
+
+	if(path_prefix_index_column_exists == true)
+	{
+		snprintf(path_prefix_index,sizeof(path_prefix_index),"path_prefix_index");
+	} else {
+		snprintf(path_prefix_index,sizeof(path_prefix_index),
+		         "(SELECT IFNULL(MIN(ID),1) FROM %s.paths) AS path_prefix_index",schema);
+	}
+
+	char view_sql[512];
+
+	snprintf(view_sql,sizeof(view_sql),
+	         "CREATE TEMP VIEW %s_files AS SELECT %s,relative_path,sha512,%s FROM %s.files;",
+	         schema,path_prefix_index,algorithm,schema);
+
+	rc = sqlite3_exec(config->db, view_sql, NULL, NULL, NULL);
+	if(rc!= SQLITE_OK ){
+		slog(false,"Can't execute (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	return(status);
+}
+
+/* A path saved against one of compared databases */
+typedef struct {
+
+	/// ID of the path in its database
+	sqlite3_int64 ID;
+
+	/// The path as it has been saved
+	char *prefix;
+
+	/// The last component of the normalized path
+	const char *name;
+
+	/// Index of the paired path of the other database,
+	/// -1 while it is not paired yet
+	ssize_t pair;
+
+} ComparedPath;
+
+/**
+ *
+ * Read all paths of the attached database in order of their IDs.
+ * The array should be released with db_compare_free_paths()
+ *
+ */
+static Return db_compare_read_paths
+(
+	const char *schema,
+	ComparedPath **paths,
+	size_t *count
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	sqlite3_stmt *select_stmt = NULL;
+
+	*paths = NULL;
+	*count = 0;
+
+	char select_sql[64];
+
+	snprintf(select_sql,sizeof(select_sql),"SELECT ID,prefix FROM %s.paths ORDER BY ID;",schema);
+
+	int rc = sqlite3_prepare_v2(config->db, select_sql, -1, &select_stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare select statement %s (%i): %s\n", select_sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	while(SUCCESS == status && SQLITE_ROW == (rc = sqlite3_step(select_stmt)))
+	{
+		ComparedPath *tmp = (ComparedPath *)realloc(*paths,(*count + 1) * sizeof(ComparedPath));
+		if(tmp == NULL)
+		{
+			slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+			status = FAILURE;
+			break;
+		}
+		*paths = tmp;
+
+		ComparedPath *path = &(*paths)[*count];
+
+		path->ID = sqlite3_column_int64(select_stmt,0);
+		path->prefix = strdup((const char *)sqlite3_column_text(select_stmt,1));
+		path->pair = -1;
+
+		if(path->prefix == NULL)
+		{
+			slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+			status = FAILURE;
+			break;
+		}
+
+		(*count)++;
+
+		// Paths saved by previous versions could be not normalized
+		normalize_path(path->prefix);
+
+		const char *slash = strrchr(path->prefix,'/');
+
+		path->name = slash != NULL && slash[1] != '\0' ? slash + 1 : path->prefix;
+	}
+	if(SUCCESS == status && SQLITE_DONE != rc) {
+		slog(false,"Select statement didn't finish with DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+	sqlite3_finalize(select_stmt);
+
+	return(status);
+}
+
+/**
+ *
+ * Release paths read by db_compare_read_paths()
+ *
+ */
+static void db_compare_free_paths
+(
+	ComparedPath *paths,
+	size_t count
+){
+	for(size_t i = 0; i < count; i++)
+	{
+		free(paths[i].prefix);
+	}
+	free(paths);
+}
+
+/**
+ *
+ * Number of paths with the name
+ *
+ */
+static size_t db_compare_count_name
+(
+	const ComparedPath *paths,
+	size_t count,
+	const char *name
+){
+	size_t found = 0;
+
+	for(size_t i = 0; i < count; i++)
+	{
+		if(strcmp(paths[i].name,name) == 0)
+		{
+			found++;
+		}
+	}
+
+	return(found);
+}
+
+/**
+ *
+ * Paths of both databases are paired by their last component,
+ * so /mnt1/data is compared with /mnt2/data whatever order the
+ * paths have been passed in. Paths whose name is not unique in
+ * either database, or has no match, are paired by their order
+ * among themselves, like /mnt1 and /mnt2 of a single path
+ *
+ */
+static Return db_compare_path_pairs(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	ComparedPath *first = NULL;
+	ComparedPath *second = NULL;
+	size_t first_count = 0;
+	size_t second_count = 0;
+
+	sqlite3_stmt *insert_stmt = NULL;
+
+	if(SUCCESS == status)
+	{
+		status = db_compare_read_paths("db1",&first,&first_count);
+	}
+
+	if(SUCCESS == status)
+	{
+		status = db_compare_read_paths("db2",&second,&second_count);
+	}
+
+	if(SUCCESS == status && first_count != second_count)
+	{
+		slog(false,"WARNING: The database %s has been built from %zu paths and the database %s from %zu paths. Files of unpaired paths are reported as absent from the other database\n",
+			config->db_file_names[0],first_count,config->db_file_names[1],second_count);
+	}
+
+	// Pair unique names
+	for(size_t i = 0; SUCCESS == status && i < first_count; i++)
+	{
+		if(db_compare_count_name(first,first_count,first[i].name) != 1
+			|| db_compare_count_name(second,second_count,first[i].name) != 1)
+		{
+			continue;
+		}
+
+		for(size_t j = 0; j < second_count; j++)
+		{
+			if(strcmp(first[i].name,second[j].name) == 0)
+			{
+				first[i].pair = (ssize_t)j;
+				second[j].pair = (ssize_t)i;
+				break;
+			}
+		}
+	}
+
+	// The rest in order
+	for(size_t i = 0, j = 0; SUCCESS == status && i < first_count; i++)
+	{
+		if(first[i].pair != -1)
+		{
+			continue;
+		}
+
+		while(j < second_count && second[j].pair != -1)
+		{
+			j++;
+		}
+
+		if(j == second_count)
+		{
+			break;
+		}
+
+		first[i].pair = (ssize_t)j;
+		second[j].pair = (ssize_t)i;
+	}
+
+	if(SUCCESS == status)
+	{
+		int rc = sqlite3_exec(config->db, "CREATE TEMP TABLE path_pairs (db1_index INTEGER NOT NULL, db2_index INTEGER NOT NULL);", NULL, NULL, NULL);
+		if(rc!= SQLITE_OK ){
+			slog(false,"Can't execute (%i): %s\n", rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+		}
+	}
+
+	const char *insert_sql = "INSERT INTO path_pairs (db1_index,db2_index) VALUES (?1,?2);";
+
+	if(SUCCESS == status)
+	{
+		int rc = sqlite3_prepare_v2(config->db, insert_sql, -1, &insert_stmt, NULL);
+		if(SQLITE_OK != rc) {
+			slog(false,"Can't prepare insert statement %s (%i): %s\n", insert_sql, rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+		}
+	}
+
+	for(size_t i = 0; SUCCESS == status && i < first_count; i++)
+	{
+		if(first[i].pair == -1)
+		{
+			slog(false,"The path %s of %s has no pair against %s\n",first[i].prefix,config->db_file_names[0],config->db_file_names[1]);
+			continue;
+		}
+
+		const ComparedPath *pair = &second[first[i].pair];
+
+		slog(true,"Files under %s of %s are compared with files under %s of %s\n",
+			first[i].prefix,config->db_file_names[0],pair->prefix,config->db_file_names[1]);
+
+		sqlite3_bind_int64(insert_stmt,1,first[i].ID);
+		sqlite3_bind_int64(insert_stmt,2,pair->ID);
+
+		int rc = sqlite3_step(insert_stmt);
+		if(SQLITE_DONE != rc)
+		{
+			slog(false,"Insert statement didn't return DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+		}
+		sqlite3_reset(insert_stmt);
+	}
+
+	for(size_t j = 0; SUCCESS == status && j < second_count; j++)
+	{
+		if(second[j].pair == -1)
+		{
+			slog(false,"The path %s of %s has no pair against %s\n",second[j].prefix,config->db_file_names[1],config->db_file_names[0]);
+		}
+	}
+
+	sqlite3_finalize(insert_stmt);
+
+	db_compare_free_paths(first,first_count);
+	db_compare_free_paths(second,second_count);
+
+	return(status);
+}
+
+/* Integrity check of a database in a thread of its own */
+typedef struct {
+
+	/// Path to the database
+	const char *db_file_path;
+
+	/// Result of the check
+	Return status;
+
+} IntegrityCheck;
+
+/**
+ *
+ * Check up the integrity of a database in a thread of its own
+ *
+ */
+static void *db_compare_test_thread(void *arg)
+{
+	IntegrityCheck *check = (IntegrityCheck *)arg;
+
+	check->status = db_test(check->db_file_path,db_test_in_full(check->db_file_path,NULL));
+
+	return(NULL);
+}
+
+/**
+ *
+ * Check up the integrity of both databases. If SQLite is
+ * thread-safe, each database is checked on a connection of
+ * its own in parallel with the other one
+ *
+ */
+static Return db_compare_test(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	IntegrityCheck first = {config->db_file_paths[0],SUCCESS};
+
+	pthread_t thread;
+
+	if(sqlite3_threadsafe() != 0
+		&& 0 == pthread_create(&thread,NULL,db_compare_test_thread,&first))
+	{
+		status = db_test(config->db_file_paths[1],db_test_in_full(config->db_file_paths[1],NULL));
+
+		pthread_join(thread,NULL);
+
+		if(SUCCESS != first.status)
+		{
+			status = first.status;
+		}
+
+		return(status);
+	}
+
+	// One by one
+	if(SUCCESS == (status = db_test(config->db_file_paths[0],db_test_in_full(config->db_file_paths[0],NULL))))
+	{
+		status = db_test(config->db_file_paths[1],db_test_in_full(config->db_file_paths[1],NULL));
+	}
+
+	return(status);
+}
 
 /**
  *
@@ -40,14 +502,7 @@ Return db_compare(void)
 	 * Check up the integrity of database files
 	 */
 
-	// First database
-	if(SUCCESS != (status = db_test(config->db_file_paths[0])))
-	{
-		return(status);
-	}
-
-	// Second database
-	if(SUCCESS != (status = db_test(config->db_file_paths[1])))
+	if(SUCCESS != (status = db_compare_test()))
 	{
 		return(status);
 	}
@@ -109,12 +564,35 @@ Return db_compare(void)
 	}
 	free(select_sql_2);
 
+	if(SUCCESS == status)
+	{
+		status = db_compare_files_view("db1");
+	}
+
+	if(SUCCESS == status)
+	{
+		status = db_compare_files_view("db2");
+	}
 
+	if(SUCCESS == status)
+	{
+		status = db_compare_path_pairs();
+	}
+
+	if(SUCCESS != status)
+	{
+		return(status);
+	}
+
+
+	/* Files are looked up against the paired path with
+	 * the index on the path and the relative path */
 	const char *compare_A_sql = "SELECT a.relative_path " \
-	                            "FROM db2.files AS a " \
-	                            "LEFT JOIN db1.files AS b on b.relative_path = a.relative_path " \
+	                            "FROM db2_files AS a " \
+	                            "LEFT JOIN path_pairs AS p ON p.db2_index = a.path_prefix_index " \
+	                            "LEFT JOIN db1_files AS b ON b.path_prefix_index = p.db1_index AND b.relative_path = a.relative_path " \
 	                            "WHERE b.relative_path IS NULL " \
-	                            "ORDER BY a.relative_path ASC;";
+	                            "ORDER BY a.path_prefix_index,a.relative_path ASC;";
 
 	rc = sqlite3_prepare_v2(config->db, compare_A_sql, -1, &select_stmt, NULL);
 	if(SQLITE_OK != rc) {
@@ -159,10 +637,11 @@ Return db_compare(void)
 	sqlite3_finalize(select_stmt);
 
 	const char *compare_B_sql = "SELECT a.relative_path " \
-	                            "FROM db1.files AS a " \
-	                            "LEFT join db2.files AS b on b.relative_path = a.relative_path " \
+	                            "FROM db1_files AS a " \
+	                            "LEFT JOIN path_pairs AS p ON p.db1_index = a.path_prefix_index " \
+	                            "LEFT JOIN db2_files AS b ON b.path_prefix_index = p.db2_index AND b.relative_path = a.relative_path " \
 	                            "WHERE b.relative_path IS NULL " \
-	                            "ORDER BY a.relative_path ASC;";
+	                            "ORDER BY a.path_prefix_index,a.relative_path ASC;";
 
 	rc = sqlite3_prepare_v2(config->db, compare_B_sql, -1, &select_stmt, NULL);
 	if(SQLITE_OK != rc) {
@@ -204,25 +683,13 @@ Return db_compare(void)
 	}
 	sqlite3_finalize(select_stmt);
 
-#if 0 // Old multiPATH solutions
-	const char *compare_checksums = "select a.relative_path from db2.files a inner join db1.files b" \
-	                                " on b.relative_path = a.relative_path " \
-	                                " and b.sha512 != a.sha512" \
-	                                " order by a.relative_path asc;";
-
-	const char *compare_checksums = "SELECT p.path,f1.relative_path " \
-	                                "FROM db1.files AS f1 " \
-	                                "JOIN db1.paths AS p ON f1.path_prefix_index = p.ID " \
-	                                "JOIN db2.files AS f2 ON f1.relative_path = f2.relative_path " \
-	                                "JOIN db2.paths AS p2 ON f2.path_prefix_index = p2.ID " \
-	                                "WHERE f1.sha512 <> f2.sha512 AND p.path = p2.path " \
-	                                "ORDER BY p.path,f1.relative_path ASC;";
-#endif
-	// One PATH solution
+	// Only checksums calculated with the same algorithm could be compared
 	const char *compare_checksums = "SELECT a.relative_path " \
-	                                "FROM db2.files AS a " \
-	                                "INNER JOIN db1.files b on b.relative_path = a.relative_path and b.sha512 != a.sha512 " \
-	                                "ORDER BY a.relative_path ASC;";
+	                                "FROM db2_files AS a " \
+	                                "INNER JOIN path_pairs AS p ON p.db2_index = a.path_prefix_index " \
+	                                "INNER JOIN db1_files AS b ON b.path_prefix_index = p.db1_index AND b.relative_path = a.relative_path " \
+	                                "AND b.algorithm = a.algorithm AND b.sha512 != a.sha512 " \
+	                                "ORDER BY a.path_prefix_index,a.relative_path ASC;";
 
 	rc = sqlite3_prepare_v2(config->db, compare_checksums, -1, &select_stmt, NULL);
 	if(SQLITE_OK != rc) {
@@ -246,21 +713,68 @@ Return db_compare(void)
 		}
 		if (first_iteration == true){
 			first_iteration = false;
-			printf("\033[1mThe SHA512 checksums of these files do not match between %s and %s\n\033[0m",config->db_file_names[0],config->db_file_names[1]);
+			printf("\033[1mThe checksums of these files do not match between %s and %s\n\033[0m",config->db_file_names[0],config->db_file_names[1]);
 		}
 
-#if 0
 		const unsigned char *relative_path = NULL;
-		const unsigned char *path_prefix = NULL;
-		path_prefix = sqlite3_column_text(select_stmt,0);
-		relative_path = sqlite3_column_text(select_stmt,1);
-#endif
+		relative_path = sqlite3_column_text(select_stmt,0);
+
+		if(relative_path != NULL){
+			printf("%s\n",relative_path);
+		} else {
+			slog(false,"General database error!\n");
+			status = FAILURE;
+			break;
+		}
+	}
+	if(SQLITE_DONE != rc) {
+		slog(false,"Select statement didn't finish with DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+	sqlite3_finalize(select_stmt);
+
+	const char *compare_algorithms = "SELECT a.relative_path,b.algorithm,a.algorithm " \
+	                                 "FROM db2_files AS a " \
+	                                 "INNER JOIN path_pairs AS p ON p.db2_index = a.path_prefix_index " \
+	                                 "INNER JOIN db1_files AS b ON b.path_prefix_index = p.db1_index AND b.relative_path = a.relative_path " \
+	                                 "AND b.algorithm != a.algorithm " \
+	                                 "ORDER BY a.path_prefix_index,a.relative_path ASC;";
+
+	rc = sqlite3_prepare_v2(config->db, compare_algorithms, -1, &select_stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare select statement (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	first_iteration = true;
+
+	bool algorithms = true;
+
+	while(SQLITE_ROW == (rc = sqlite3_step(select_stmt)))
+	{
+		the_databases_are_equal = false;
+		algorithms              = false;
+
+		// Interrupt the loop smoothly
+		// Interrupt when Ctrl+C
+		if(global_interrupt_flag == true){
+			break;
+		}
+		if (first_iteration == true){
+			first_iteration = false;
+			printf("\033[1mThe checksums of these files can't be compared since they were calculated with different hash algorithms against %s and %s\n\033[0m",config->db_file_names[0],config->db_file_names[1]);
+		}
 
 		const unsigned char *relative_path = NULL;
 		relative_path = sqlite3_column_text(select_stmt,0);
 
+		int algorithm_1 = sqlite3_column_int(select_stmt,1);
+		int algorithm_2 = sqlite3_column_int(select_stmt,2);
+
 		if(relative_path != NULL){
-			printf("%s\n",relative_path);
+			printf("%s %s/%s\n",relative_path,
+			       hash_algorithm_name((HashAlgorithm)algorithm_1),
+			       hash_algorithm_name((HashAlgorithm)algorithm_2));
 		} else {
 			slog(false,"General database error!\n");
 			status = FAILURE;
@@ -277,9 +791,9 @@ Return db_compare(void)
 	{
 		printf("\033[1mAll files are identical against %s and %s\n\033[0m",config->db_file_names[0],config->db_file_names[1]);
 	}
-	if(checksums == true)
+	if(checksums == true && algorithms == true)
 	{
-		printf("\033[1mAll SHA512 checksums of files are identical against %s and %s\n\033[0m",config->db_file_names[0],config->db_file_names[1]);
+		printf("\033[1mAll checksums of files are identical against %s and %s\n\033[0m",config->db_file_names[0],config->db_file_names[1]);
 	}
 
 	if(the_databases_are_equal == true)
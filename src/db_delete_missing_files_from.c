@@ -1,10 +1,108 @@
 #include "precizer.h"
 #include <unistd.h>
 
+/**
+ *
+ * SQL function file_is_missing(prefix,relative_path). True if the
+ * file doesn't exist on the file system. Called only for files that
+ * have not been seen by the current scan, like files deeper than
+ * --maxdepth or in directories that could not be read
+ *
+ */
+static void file_is_missing
+(
+	sqlite3_context *context,
+	int argc,
+	sqlite3_value **argv
+){
+	(void)argc;
+
+	const char *runtime_path_prefix = (const char *)sqlite3_value_text(argv[0]);
+	const char *relative_path = (const char *)sqlite3_value_text(argv[1]);
+
+	if(runtime_path_prefix == NULL || relative_path == NULL)
+	{
+		sqlite3_result_int(context,1);
+		return;
+	}
+
+	size_t runtime_path_prefix_size = strlen(runtime_path_prefix);
+	size_t relative_path_size = strlen(relative_path);
+
+	// One for '/' and second for '\0' at the end of the line
+	char *absolute_path = (char *)malloc(runtime_path_prefix_size + relative_path_size + 2);
+	if(absolute_path == NULL)
+	{
+		sqlite3_result_error_nomem(context);
+		return;
+	}
+
+	memcpy(absolute_path,runtime_path_prefix,runtime_path_prefix_size);
+	absolute_path[runtime_path_prefix_size] = '/';
+	memcpy(absolute_path + runtime_path_prefix_size + 1,relative_path,relative_path_size + 1);
+
+	sqlite3_result_int(context,access(absolute_path,F_OK) != 0);
+
+	free(absolute_path);
+}
+
+/**
+ *
+ * SQL function file_is_ignored(relative_path). True if the
+ * file matches PCRE2 regular expressions passed with --ignore
+ * and doesn't match the ones passed with --include
+ *
+ */
+static void file_is_ignored
+(
+	sqlite3_context *context,
+	int argc,
+	sqlite3_value **argv
+){
+	(void)argc;
+
+	const char *relative_path = (const char *)sqlite3_value_text(argv[0]);
+
+	if(relative_path == NULL)
+	{
+		sqlite3_result_int(context,0);
+		return;
+	}
+
+	// Don't show extra messages
+	bool showed_once = true;
+
+	/* PCRE2 regexp to include the file */
+	Include response = include(relative_path,&showed_once);
+
+	if(DO_NOT_INCLUDE == response)
+	{
+		/* PCRE2 regexp to ignore the file */
+		Ignore result = ignore(relative_path,&showed_once);
+
+		if(FAIL_REGEXP_IGNORE == result)
+		{
+			sqlite3_result_error(context,"PCRE2 regular expression of --ignore has failed",-1);
+			return;
+		}
+
+		sqlite3_result_int(context,IGNORE == result);
+
+	} else if (FAIL_REGEXP_INCLUDE == response)
+	{
+		sqlite3_result_error(context,"PCRE2 regular expression of --include has failed",-1);
+
+	} else {
+		sqlite3_result_int(context,0);
+	}
+}
+
 /**
  *
  * Remove information from the database about files that had been deleted
- * on the file system or have been ignored
+ * on the file system or have been ignored. Files seen by the current
+ * scan have been stamped with its generation, so all others are removed
+ * with the single statement that returns their paths to be shown
  *
  */
 Return db_delete_missing_files_from(void)
@@ -30,121 +128,94 @@ Return db_delete_missing_files_from(void)
 		}
 	}
 
-	sqlite3_stmt *select_stmt = NULL;
-	int rc = 0;
+	// Don't do anything in case of --dry_run or when
+	// the scan has been interrupted and not all files
+	// have been seen
+	if(config->dry_run == true || global_interrupt_flag == true)
+	{
+		return(status);
+	}
+
+	int rc = sqlite3_create_function(config->db,"file_is_missing",2,SQLITE_UTF8,NULL,file_is_missing,NULL,NULL);
+
+	if(SQLITE_OK == rc)
+	{
+		rc = sqlite3_create_function(config->db,"file_is_ignored",1,SQLITE_UTF8,NULL,file_is_ignored,NULL,NULL);
+	}
+
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't create SQL function (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+		return(status);
+	}
+
+	sqlite3_stmt *delete_stmt = NULL;
+
+	/* Files that have not been seen are checked up on the file
+	 * system against the path they have been found in. CASE makes
+	 * sure that the others are not. Files of paths that are not
+	 * saved against the DB anymore have no prefix and are missing */
+	const char *delete_sql = "DELETE FROM files WHERE " \
+	                         "CASE WHEN generation < ?1 THEN file_is_missing((SELECT prefix FROM paths WHERE paths.ID = files.path_prefix_index),relative_path) ELSE 0 END " \
+	                         "RETURNING relative_path,0;";
+
+	const char *delete_ignored_sql = "DELETE FROM files WHERE " \
+	                                 "CASE WHEN generation < ?1 THEN file_is_missing((SELECT prefix FROM paths WHERE paths.ID = files.path_prefix_index),relative_path) ELSE 0 END " \
+	                                 "OR file_is_ignored(relative_path) " \
+	                                 "RETURNING relative_path,file_is_ignored(relative_path);";
 
-#if 0 // Old multiPATH solutions
-	const char *select_sql = "SELECT files.ID,paths.prefix,files.relative_path FROM files LEFT JOIN paths ON files.path_prefix_index = paths.ID;";
-#endif
-	const char *select_sql = "SELECT files.ID,paths.prefix,files.relative_path FROM files,paths;";
+	if(config->db_clean_ignored == true)
+	{
+		delete_sql = delete_ignored_sql;
+	}
 
-	rc = sqlite3_prepare_v2(config->db, select_sql, -1, &select_stmt, NULL);
+	rc = sqlite3_prepare_v2(config->db, delete_sql, -1, &delete_stmt, NULL);
 	if(SQLITE_OK != rc) {
-		slog(false,"Can't prepare select statement (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		slog(false,"Can't prepare delete statement %s (%i): %s\n", delete_sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	rc = sqlite3_bind_int64(delete_stmt, 1, config->generation);
+	if(SQLITE_OK != rc) {
+		slog(false,"Error binding value in delete (%i): %s\n", rc, sqlite3_errmsg(config->db));
 		status = FAILURE;
 	}
 
 	bool first_iteration = true;
 
-	while(SQLITE_ROW == (rc = sqlite3_step(select_stmt)))
+	while(SUCCESS == status && SQLITE_ROW == (rc = sqlite3_step(delete_stmt)))
 	{
-		/* Interrupt the loop smoothly */
-		/* Interrupt when Ctrl+C */
-		if(global_interrupt_flag == true){
-			break;
-		}
+		const char *relative_path = (const char *)sqlite3_column_text(delete_stmt,0);
+		bool clean_ignored = sqlite3_column_int(delete_stmt,1) != 0;
 
-		sqlite_int64 ID = sqlite3_column_int64(select_stmt,0);
-		const char *runtime_path_prefix = NULL;
-		runtime_path_prefix = (const char *)sqlite3_column_text(select_stmt,1);
-		const char *relative_path = NULL;
-		relative_path = (const char *)sqlite3_column_text(select_stmt,2);
-		char *absolute_path = NULL;
-
-		bool path_was_removed_from_db = false;
-		bool clean_ignored = false;
-
-		if(runtime_path_prefix != NULL && relative_path != NULL){
-
-			/*
-			 * Remove from the database mention of
-			 * files that matches the regular expression
-			 * passed through the ignore option(s)
-			 *
-			 */
-			if(config->db_clean_ignored == true)
-			{
-				/*
-				 *
-				 * PCRE2 regexp to include the file
-				 *
-				 */
-
-				// Don't show extra messages
-				bool showed_once = true;
-
-				Include response = include(relative_path,&showed_once);
-
-				if(DO_NOT_INCLUDE == response)
-				{
-					/*
-					 *
-					 * PCRE2 regexp to ignore the file
-					 *
-					 */
-
-					Ignore result = ignore(relative_path,&showed_once);
-
-					if(IGNORE == result)
-					{
-						clean_ignored = true;
-
-					} else if (FAIL_REGEXP_IGNORE == result)
-					{
-						status = FAILURE;
-					}
-
-				} else if (FAIL_REGEXP_INCLUDE == response)
-				{
-					status = FAILURE;
-					break;
-				}
-			}
+		if (first_iteration == true){
 
-			// The variable in the stack is extremely fast
-			size_t runtime_path_prefix_size = strlen(runtime_path_prefix);
-			size_t relative_path_size = strlen(relative_path);
-			absolute_path = (char *)calloc(runtime_path_prefix_size + relative_path_size + 2,sizeof(char)); // One for '/' and second for '\0' at the end of the line
-			if(absolute_path == NULL)
+			if(config->update == true && config->something_has_been_changed == false)
 			{
-				slog(false,"ERROR: Memory allocation did not complete successfully!\n");
-				status = FAILURE;
-				break;
+				slog(false,"The \033[1m--update\033[0m option has been used, so the information about files will be deleted against the database %s\n",config->db_file_name);
 			}
-			strcpy(absolute_path,runtime_path_prefix);
-			absolute_path[runtime_path_prefix_size] = '/';
-			absolute_path[runtime_path_prefix_size + 1] = '\0';
-			strcat(absolute_path,relative_path);
-			absolute_path[runtime_path_prefix_size + relative_path_size + 1] = '\0';
-		} else {
-			path_was_removed_from_db = true;
+
+			first_iteration = false;
+
+			// Reflect changes in global
+			config->something_has_been_changed = true;
+
+			slog(false,"\033[1mThese files are ignored or no longer exist and will be deleted against the DB %s:\n\033[0m",config->db_file_name);
 		}
 
-		if(clean_ignored == true || path_was_removed_from_db == true || access(absolute_path,F_OK) != 0)
+		if(clean_ignored == true)
 		{
-			status = db_delete_the_file_by_id(&ID,&first_iteration,&clean_ignored,relative_path);
+			slog(false,"clean ignored %s\n",relative_path);
+		} else {
+			slog(false,"%s\n",relative_path);
 		}
-		free(absolute_path);
 	}
-	if(SQLITE_DONE != rc) {
-		if(global_interrupt_flag == false)
-		{
-			slog(false,"Select statement didn't finish with DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
-			status = FAILURE;
-		}
+	if(SUCCESS == status && SQLITE_DONE != rc) {
+		slog(false,"Delete statement didn't return DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
 	}
 
-	sqlite3_finalize(select_stmt);
+	sqlite3_finalize(delete_stmt);
 
 	return(status);
 }
@@ -0,0 +1,123 @@
+#include "precizer.h"
+
+/**
+ *
+ * Read totals saved against paths by db_save_totals() at the
+ * end of previous runs. Only one row per path is read. They
+ * are missing if any path has never been walked to the end
+ *
+ */
+static Return saved_totals
+(
+	size_t *files,
+	size_t *size_in_bytes,
+	bool *saved
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	sqlite3_stmt *select_stmt = NULL;
+	int rc = 0;
+
+	*saved = false;
+
+	const char *select_sql = "SELECT COUNT(*),COUNT(files),COUNT(size_in_bytes),IFNULL(SUM(files),0),IFNULL(SUM(size_in_bytes),0) FROM paths;";
+
+	rc = sqlite3_prepare_v2(config->db, select_sql, -1, &select_stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare select statement %s (%i): %s\n", select_sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	while(SQLITE_ROW == (rc = sqlite3_step(select_stmt)))
+	{
+		sqlite3_int64 paths = sqlite3_column_int64(select_stmt,0);
+
+		if(paths > 0
+			&& sqlite3_column_int64(select_stmt,1) == paths
+			&& sqlite3_column_int64(select_stmt,2) == paths)
+		{
+			*files = (size_t)sqlite3_column_int64(select_stmt,3);
+			*size_in_bytes = (size_t)sqlite3_column_int64(select_stmt,4);
+			*saved = true;
+		}
+	}
+	if(SQLITE_DONE != rc) {
+		slog(false,"Select statement didn't finish with DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+	sqlite3_finalize(select_stmt);
+
+	return(status);
+}
+
+/**
+ *
+ * @brief Estimate the number and the total size of files
+ * to be traversed from the previous run
+ * @details Totals of the last complete walk are saved against
+ * every path. Databases without them are estimated from stat
+ * structures every file saved against the database carries.
+ * Either way the file hierarchy is not walked once again.
+ * Nothing is estimated for a new database
+ *
+ */
+Return db_estimate_totals
+(
+	size_t *files,
+	size_t *size_in_bytes
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	*files = 0;
+	*size_in_bytes = 0;
+
+	// Don't do anything
+	if(config->db_already_exists == false
+		|| db_preload_totals(files,size_in_bytes) == true)
+	{
+		return(status);
+	}
+
+	bool saved = false;
+
+	if(SUCCESS != (status = saved_totals(files,size_in_bytes,&saved)) || saved == true)
+	{
+		return(status);
+	}
+
+	sqlite3_stmt *select_stmt = NULL;
+	int rc = 0;
+
+	const char *select_sql = "SELECT stat FROM files;";
+
+	rc = sqlite3_prepare_v2(config->db, select_sql, -1, &select_stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare select statement %s (%i): %s\n", select_sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	while(SQLITE_ROW == (rc = sqlite3_step(select_stmt)))
+	{
+		const void *blob = sqlite3_column_blob(select_stmt,0);
+
+		(*files)++;
+
+		if(blob != NULL && sqlite3_column_bytes(select_stmt,0) == (int)sizeof(struct stat))
+		{
+			struct stat stat;
+			memcpy(&stat,blob,sizeof(struct stat));
+			*size_in_bytes += (size_t)stat.st_size;
+		}
+	}
+	if(SQLITE_DONE != rc) {
+		slog(false,"Select statement didn't finish with DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+	sqlite3_finalize(select_stmt);
+
+	return(status);
+}
@@ -0,0 +1,57 @@
+#include "precizer.h"
+
+/**
+ *
+ * @brief Choose the hash algorithm for new files
+ * @details If --hash has not been specified, new files
+ * get the algorithm most of files against the database
+ * already have. So a database created with BLAKE3 stays
+ * BLAKE3 without the need to repeat the option on every
+ * update
+ *
+ */
+Return db_get_hash_algorithm(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	// Don't do anything
+	if(config->compare == true
+		|| config->hash_algorithm_specified == true
+		|| config->db_already_exists == false)
+	{
+		return(status);
+	}
+
+	sqlite3_stmt *select_stmt = NULL;
+	int rc = 0;
+
+	const char *select_sql = "SELECT algorithm FROM files GROUP BY algorithm ORDER BY COUNT(*) DESC LIMIT 1;";
+
+	rc = sqlite3_prepare_v2(config->db, select_sql, -1, &select_stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare select statement %s (%i): %s\n", select_sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	while(SQLITE_ROW == (rc = sqlite3_step(select_stmt)))
+	{
+		int algorithm = sqlite3_column_int(select_stmt,0);
+
+		if(hash_digest_length((HashAlgorithm)algorithm) > 0)
+		{
+			// Whether a file is hashed as a tree depends on its size
+			config->hash_algorithm = hash_plain_of((HashAlgorithm)algorithm);
+		}
+	}
+	if(SQLITE_DONE != rc) {
+		slog(false,"Select statement didn't finish with DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+	sqlite3_finalize(select_stmt);
+
+	slog(true,"New files will be hashed with %s\n",hash_algorithm_name(config->hash_algorithm));
+
+	return(status);
+}
@@ -1,5 +1,133 @@
 #include "precizer.h"
 
+// Pages of the write-ahead log after which it is written
+// back into the database. Bigger than the default 1000,
+// so a checkpoint doesn't follow every batch of rows
+#define WAL_AUTOCHECKPOINT 16384
+
+/**
+ *
+ * Set journaling and syncs of the database chosen with
+ * --durability. The journal mode is saved in the database
+ * file, so it is left as is by --dry-run
+ *
+ */
+static Return set_durability(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	const char *journal_mode = "OFF";
+	const char *synchronous = "OFF";
+
+	if(config->durability == DURABILITY_NORMAL)
+	{
+		journal_mode = "WAL";
+		synchronous = "NORMAL";
+
+	} else if(config->durability == DURABILITY_FULL)
+	{
+		journal_mode = "WAL";
+		synchronous = "FULL";
+	}
+
+	char sql[128];
+
+	if(config->dry_run == false)
+	{
+		snprintf(sql,sizeof(sql),"PRAGMA journal_mode = %s;",journal_mode);
+
+		sqlite3_stmt *stmt = NULL;
+
+		int rc = sqlite3_prepare_v2(config->db, sql, -1, &stmt, NULL);
+		if(SQLITE_OK != rc) {
+			slog(false,"Can't prepare statement %s (%i): %s\n", sql, rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+		}
+
+		if(SUCCESS == status && SQLITE_ROW == (rc = sqlite3_step(stmt)))
+		{
+			// The mode the database is in now
+			const char *mode = (const char *)sqlite3_column_text(stmt,0);
+
+			if(mode != NULL && strcasecmp(mode,journal_mode) != 0 && strcmp(mode,"memory") != 0)
+			{
+				slog(false,"WARNING: The journal mode of the database %s stays %s instead of %s\n",config->db_file_name,mode,journal_mode);
+			}
+
+		} else if(SUCCESS == status) {
+			slog(false,"Statement %s didn't return a row (%i): %s\n", sql, rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+		}
+		sqlite3_finalize(stmt);
+	}
+
+	if(SUCCESS == status)
+	{
+		snprintf(sql,sizeof(sql),"PRAGMA synchronous = %s;PRAGMA wal_autocheckpoint = %d;",synchronous,WAL_AUTOCHECKPOINT);
+
+		int rc = sqlite3_exec(config->db, sql, NULL, NULL, NULL);
+		if(rc!= SQLITE_OK ){
+			slog(false,"Can't execute %s (%i): %s\n", sql, rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+		}
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Space of deleted files is given back by db_vacuum() step by
+ * step. The mode takes effect only for a brand new DB, so it is
+ * set only while the file has no pages yet. Set on every open it
+ * would rewrite the header of the file each time, --dry-run too
+ *
+ */
+static Return set_auto_vacuum(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	sqlite3_stmt *stmt = NULL;
+	sqlite3_int64 page_count = -1;
+
+	const char *sql = "PRAGMA page_count;";
+
+	int rc = sqlite3_prepare_v2(config->db, sql, -1, &stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare statement %s (%i): %s\n", sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	if(SUCCESS == status)
+	{
+		if(SQLITE_ROW == (rc = sqlite3_step(stmt)))
+		{
+			page_count = sqlite3_column_int64(stmt,0);
+		} else {
+			slog(false,"Statement %s didn't return a row (%i): %s\n", sql, rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+		}
+	}
+	sqlite3_finalize(stmt);
+
+	if(SUCCESS == status && page_count == 0)
+	{
+		sql = "PRAGMA auto_vacuum = INCREMENTAL;";
+
+		rc = sqlite3_exec(config->db, sql, NULL, NULL, NULL);
+		if(rc!= SQLITE_OK ){
+			slog(false,"Can't execute %s (%i): %s\n", sql, rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+		}
+	}
+
+	return(status);
+}
+
 /**
  *
  * Initialize SQLite database
@@ -43,8 +171,17 @@ Return db_init(void)
 	// Don't do anything with default database in cases:
 	if(config->dry_run == false || config->compare == false || config->update == false)
 	{
-
-#if 0 // Old multiPATH solution
+		/* Full runtime paths are stored in the table 'paths'. Every file
+		 * refers to the path it was found in, so the same relative path
+		 * could be saved against several paths passed as arguments.
+		 * The index of files is built in db_bulk_load_begin() or
+		 * after the first run has loaded them */
+		/* The column 'sha512' keeps checksums of any algorithm from the
+		 * column 'algorithm'. The name stays for compatibility */
+		/* The column 'generation' of a file is the last scan that has
+		 * seen the file. The one of a path is the last scan started */
+		/* Columns 'files' and 'size_in_bytes' of a path are totals of
+		 * the last complete walk, an estimate for the next --progress */
 		const char *sql = "PRAGMA foreign_keys=OFF;" \
 		                  "BEGIN TRANSACTION;" \
 		                  "CREATE TABLE IF NOT EXISTS files("  \
@@ -55,29 +192,20 @@ Return db_init(void)
 		                  "sha512 BLOB DEFAULT NULL," \
 		                  "stat BLOB DEFAULT NULL," \
 		                  "mdContext BLOB DEFAULT NULL," \
-		                  "CONSTRAINT full_path UNIQUE (path_prefix_index, relative_path) ON CONFLICT FAIL);" \
-		                  "CREATE INDEX IF NOT EXISTS full_path_ASC ON files (path_prefix_index, relative_path ASC);" \
+		                  "algorithm INTEGER NOT NULL DEFAULT 1," \
+		                  "generation INTEGER NOT NULL DEFAULT 0);" \
 		                  "CREATE TABLE IF NOT EXISTS paths (" \
 		                  "ID INTEGER PRIMARY KEY UNIQUE NOT NULL," \
-		                  "prefix TEXT NOT NULL UNIQUE);" \
+		                  "prefix TEXT NOT NULL UNIQUE," \
+		                  "generation INTEGER NOT NULL DEFAULT 0," \
+		                  "files INTEGER DEFAULT NULL," \
+		                  "size_in_bytes INTEGER DEFAULT NULL);" \
 		                  "COMMIT;";
-#endif
 
-		/* Full runtime path is stored in the table 'paths' */
-		const char *sql = "PRAGMA foreign_keys=OFF;" \
-		                  "BEGIN TRANSACTION;" \
-		                  "CREATE TABLE IF NOT EXISTS files("  \
-		                  "ID INTEGER PRIMARY KEY NOT NULL," \
-		                  "offset INTEGER DEFAULT NULL," \
-		                  "relative_path TEXT UNIQUE NOT NULL," \
-		                  "sha512 BLOB DEFAULT NULL," \
-		                  "stat BLOB DEFAULT NULL," \
-		                  "mdContext BLOB DEFAULT NULL);" \
-		                  "CREATE UNIQUE INDEX IF NOT EXISTS 'TEXT_ASC' ON 'files' ('relative_path' ASC);" \
-		                  "CREATE TABLE IF NOT EXISTS paths (" \
-		                  "ID INTEGER PRIMARY KEY UNIQUE NOT NULL," \
-		                  "prefix TEXT NOT NULL UNIQUE);" \
-		                  "COMMIT;";
+		if(SUCCESS == status)
+		{
+			status = set_auto_vacuum();
+		}
 
 		/* Execute SQL statement */
 		rc = sqlite3_exec(config->db, sql, NULL, NULL, NULL);
@@ -87,13 +215,17 @@ Return db_init(void)
 		} else {
 			slog(true,"The database has been successfully initialized\n");
 		}
+
+		if(SUCCESS == status && config->compare == false)
+		{
+			// Bring databases created by previous versions up to date
+			status = db_upgrade();
+		}
 	}
 
 	// Tune the DB performance
 	const char *pragma_sql = "PRAGMA page_size = 4096;" \
-	                         "PRAGMA cache_size = 524288;" \
-	                         "PRAGMA journal_mode = OFF;" \
-	                         "PRAGMA synchronous = OFF;";
+	                         "PRAGMA cache_size = 524288;";
 
 	// Set SQLite pragmas
 	rc = sqlite3_exec(config->db, pragma_sql, NULL, NULL, NULL);
@@ -102,6 +234,12 @@ Return db_init(void)
 		status = FAILURE;
 	}
 
+	if(SUCCESS == status)
+	{
+		// Journaling and syncs set with --durability
+		status = set_durability();
+	}
+
 	const char *inmemory_db = "ATTACH DATABASE ':memory:' AS runtime_paths_id;" \
 	                          "CREATE TABLE if not exists runtime_paths_id.the_path_id_does_not_exists" \
 	                          "(path_id INTEGER UNIQUE NOT NULL);";
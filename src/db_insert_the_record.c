@@ -9,14 +9,13 @@
  */
 Return db_insert_the_record
 (
-#if 0 // Old multiPATH solution
 	const sqlite3_int64 *path_prefix_index,
-#endif
 	const char *relative_path,
 	const sqlite3_int64 *offset,
-	const unsigned char *sha512,
+	HashAlgorithm algorithm,
+	const unsigned char *checksum,
 	const struct stat *stat,
-	const SHA512_Context *mdContext
+	const HashState *mdContext
 ){
 	/// The status that will be passed to return() before exiting.
 	/// By default, the function worked without errors.
@@ -31,18 +30,8 @@ Return db_insert_the_record
 	/* Insert to DB */
 	int rc = 0;
 
-#if 0 // Old multiPATH solution
-	const char *insert_sql = "INSERT INTO files (offset,path_prefix_index,relative_path,sha512,stat,mdContext) VALUES (?1, ?2, ?3, ?4, ?5, ?6);";
-#endif
-	const char *insert_sql = "INSERT INTO files (offset,relative_path,sha512,stat,mdContext) VALUES (?1, ?2, ?3, ?4, ?5);";
-	sqlite3_stmt *insert_stmt = NULL;
-
-	/* Create SQL statement. Prepare to write */
-	rc = sqlite3_prepare_v2(config->db, insert_sql, -1, &insert_stmt, NULL);
-	if(SQLITE_OK != rc) {
-		slog(false,"Can't prepare insert statement %s (%i): %s\n", insert_sql, rc, sqlite3_errmsg(config->db));
-		status = FAILURE;
-	}
+	/* The statement has been prepared once for all files */
+	sqlite3_stmt *insert_stmt = config->statements.insert_file;
 
 	if(*offset == 0){
 		rc = sqlite3_bind_null(insert_stmt, 1);
@@ -54,14 +43,6 @@ Return db_insert_the_record
 		status = FAILURE;
 	}
 
-#if 0 // Old multiPATH solution
-	rc = sqlite3_bind_int64(insert_stmt, 2, *path_prefix_index);
-	if(SQLITE_OK != rc) {
-		printf("Error binding value in insert (%i): %s\n", rc, sqlite3_errmsg(config->db));
-		status = FAILURE;
-	}
-#endif
-
 	rc = sqlite3_bind_text(insert_stmt, 2, relative_path, (int)strlen(relative_path), NULL);
 	if(SQLITE_OK != rc) {
 		slog(false,"Error binding value in insert (%i): %s\n", rc, sqlite3_errmsg(config->db));
@@ -69,7 +50,7 @@ Return db_insert_the_record
 	}
 
 	if(*offset == 0){
-		rc = sqlite3_bind_blob(insert_stmt, 3, sha512, SHA512_DIGEST_LENGTH, NULL);
+		rc = sqlite3_bind_blob(insert_stmt, 3, checksum, (int)hash_digest_length(algorithm), NULL);
 	} else {
 		rc = sqlite3_bind_null(insert_stmt, 3);
 	}
@@ -87,8 +68,28 @@ Return db_insert_the_record
 	if(*offset == 0){
 		rc = sqlite3_bind_null(insert_stmt, 5);
 	} else {
-		rc = sqlite3_bind_blob(insert_stmt, 5, mdContext, sizeof(SHA512_Context), NULL);
+		rc = sqlite3_bind_blob(insert_stmt, 5, mdContext, (int)hash_context_size(algorithm), NULL);
+	}
+	if(SQLITE_OK != rc) {
+		slog(false,"Error binding value in insert (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	rc = sqlite3_bind_int(insert_stmt, 6, (int)algorithm);
+	if(SQLITE_OK != rc) {
+		slog(false,"Error binding value in insert (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
 	}
+
+	// The file has been seen by the current scan
+	rc = sqlite3_bind_int64(insert_stmt, 7, config->generation);
+	if(SQLITE_OK != rc) {
+		slog(false,"Error binding value in insert (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	// The path passed as an argument the file has been found in
+	rc = sqlite3_bind_int64(insert_stmt, 8, *path_prefix_index);
 	if(SQLITE_OK != rc) {
 		slog(false,"Error binding value in insert (%i): %s\n", rc, sqlite3_errmsg(config->db));
 		status = FAILURE;
@@ -101,7 +102,13 @@ Return db_insert_the_record
 		status = FAILURE;
 	}
 
-	sqlite3_finalize(insert_stmt);
+	db_release_statement(insert_stmt);
+
+	if(SUCCESS == status)
+	{
+		// Rows are committed in batches
+		status = db_transaction_written();
+	}
 
 	return(status);
 }
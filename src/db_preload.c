@@ -0,0 +1,407 @@
+#include "precizer.h"
+
+/**
+ *
+ * @file db_preload.c
+ * @brief Metadata of all files saved against the DB kept in memory
+ * @details With --preload the table 'files' is read once at start
+ * into a hash table keyed by the path the file has been found in
+ * and the relative path. A file that is not in the table is new and
+ * a file that has been hashed to the end is compared against the
+ * table without any query to the database. Only files with
+ * unfinished hashing are read from the database, because their
+ * hashing state is too big to be kept for every file.
+ *
+ */
+
+/* Metadata of one file */
+typedef struct {
+
+	/// Hash of the path prefix index and the relative path
+	uint64_t hash;
+
+	/// ID of the path the file has been found in
+	sqlite3_int64 path_prefix_index;
+
+	/// Offset of the relative path in the string pool
+	size_t path;
+
+	/// DB row ID
+	sqlite3_int64 ID;
+
+	/// Offset of unfinished hashing
+	sqlite3_int64 offset;
+
+	/// Size of the file
+	off_t size;
+
+	/// Modification time
+	struct timespec mtim;
+
+	/// Time of last status change
+	struct timespec ctim;
+
+	/// Hash algorithm the checksum has been calculated with
+	HashAlgorithm algorithm;
+
+} PreloadedFile;
+
+struct Preload {
+
+	/// All files
+	PreloadedFile *files;
+
+	/// Number of files
+	size_t count;
+
+	/// Allocated files
+	size_t allocated;
+
+	/// Zero-terminated relative paths one after another
+	char *paths;
+
+	/// Bytes used in the pool
+	size_t paths_size;
+
+	/// Allocated bytes of the pool
+	size_t paths_allocated;
+
+	/// Open addressing. Index of a file plus 1, 0 is empty
+	size_t *slots;
+
+	/// Number of slots. Power of 2
+	size_t capacity;
+
+	/// Total size of all files
+	size_t size_in_bytes;
+
+};
+
+/**
+ *
+ * FNV-1a hash of a path prefix index and a relative path
+ *
+ */
+__attribute__((pure)) static uint64_t path_hash
+(
+	sqlite3_int64 path_prefix_index,
+	const char *relative_path
+){
+	uint64_t hash = 14695981039346656037ULL;
+
+	hash ^= (uint64_t)path_prefix_index;
+	hash *= 1099511628211ULL;
+
+	for(const unsigned char *c = (const unsigned char *)relative_path; *c != '\0'; c++)
+	{
+		hash ^= *c;
+		hash *= 1099511628211ULL;
+	}
+
+	return(hash);
+}
+
+/**
+ *
+ * Append one row of the table 'files'
+ *
+ */
+static Return preload_append
+(
+	Preload *preload,
+	sqlite3_stmt *select_stmt
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	const char *relative_path = (const char *)sqlite3_column_text(select_stmt,0);
+
+	if(relative_path == NULL)
+	{
+		return(status);
+	}
+
+	size_t length = strlen(relative_path) + 1;
+
+	if(preload->count == preload->allocated)
+	{
+		size_t allocated = preload->allocated > 0 ? preload->allocated * 2 : 4096;
+		PreloadedFile *files = (PreloadedFile *)realloc(preload->files,allocated * sizeof(PreloadedFile));
+
+		if(files == NULL)
+		{
+			slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+			status = FAILURE;
+			return(status);
+		}
+
+		preload->files = files;
+		preload->allocated = allocated;
+	}
+
+	if(preload->paths_size + length > preload->paths_allocated)
+	{
+		size_t allocated = preload->paths_allocated > 0 ? preload->paths_allocated * 2 : 256 * 1024;
+
+		while(preload->paths_size + length > allocated)
+		{
+			allocated *= 2;
+		}
+
+		char *paths = (char *)realloc(preload->paths,allocated);
+
+		if(paths == NULL)
+		{
+			slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+			status = FAILURE;
+			return(status);
+		}
+
+		preload->paths = paths;
+		preload->paths_allocated = allocated;
+	}
+
+	PreloadedFile *file = &preload->files[preload->count++];
+	memset(file,0,sizeof(PreloadedFile));
+
+	file->path_prefix_index = sqlite3_column_int64(select_stmt,5);
+	file->hash = path_hash(file->path_prefix_index,relative_path);
+	file->path = preload->paths_size;
+	memcpy(preload->paths + preload->paths_size,relative_path,length);
+	preload->paths_size += length;
+
+	file->ID = sqlite3_column_int64(select_stmt,1);
+	file->offset = sqlite3_column_int64(select_stmt,2);
+	int algorithm = sqlite3_column_int(select_stmt,4);
+	file->algorithm = (HashAlgorithm)algorithm;
+
+	const void *blob = sqlite3_column_blob(select_stmt,3);
+
+	if(blob != NULL && sqlite3_column_bytes(select_stmt,3) == (int)sizeof(struct stat))
+	{
+		struct stat stat;
+		memcpy(&stat,blob,sizeof(struct stat));
+
+		file->size = stat.st_size;
+		file->mtim = stat.st_mtim;
+		file->ctim = stat.st_ctim;
+
+		preload->size_in_bytes += (size_t)stat.st_size;
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Build the hash table over all appended files
+ *
+ */
+static Return preload_index
+(
+	Preload *preload
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	// At most a half of slots is used
+	preload->capacity = 1024;
+
+	while(preload->capacity < preload->count * 2)
+	{
+		preload->capacity *= 2;
+	}
+
+	preload->slots = (size_t *)calloc(preload->capacity,sizeof(size_t));
+
+	if(preload->slots == NULL)
+	{
+		slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+		status = FAILURE;
+		return(status);
+	}
+
+	const size_t mask = preload->capacity - 1;
+
+	for(size_t i = 0; i < preload->count; i++)
+	{
+		size_t slot = (size_t)preload->files[i].hash & mask;
+
+		while(preload->slots[slot] != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+
+		preload->slots[slot] = i + 1;
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Read metadata of all files saved against the DB
+ * into memory if --preload has been specified
+ *
+ */
+Return db_preload(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	// Don't do anything
+	if(config->preload == false
+		|| config->compare == true
+		|| config->db_already_exists == false)
+	{
+		return(status);
+	}
+
+	Preload *preload = (Preload *)calloc(1,sizeof(Preload));
+	if(preload == NULL)
+	{
+		slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+		status = FAILURE;
+		return(status);
+	}
+
+	sqlite3_stmt *select_stmt = NULL;
+	int rc = 0;
+
+	const char *select_sql = "SELECT relative_path,ID,offset,stat,algorithm,path_prefix_index FROM files;";
+
+	rc = sqlite3_prepare_v2(config->db, select_sql, -1, &select_stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare select statement %s (%i): %s\n", select_sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	while(SUCCESS == status && SQLITE_ROW == (rc = sqlite3_step(select_stmt)))
+	{
+		status = preload_append(preload,select_stmt);
+	}
+	if(SUCCESS == status && SQLITE_DONE != rc) {
+		slog(false,"Select statement didn't finish with DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+	sqlite3_finalize(select_stmt);
+
+	if(SUCCESS == status)
+	{
+		status = preload_index(preload);
+	}
+
+	if(SUCCESS == status)
+	{
+		config->preloaded = preload;
+
+		slog(true,"Metadata of %zu files has been preloaded from the database\n",preload->count);
+	} else {
+		db_preload_free(preload);
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Find the file in preloaded metadata. Returns false if the DB
+ * has to be queried anyway: nothing has been preloaded or
+ * hashing of the file has not been finished. Otherwise the DB
+ * row is filled in and the file is marked as absent from the
+ * DB if it is not there
+ *
+ */
+bool db_preload_lookup
+(
+	DBrow *dbrow,
+	const sqlite3_int64 *path_prefix_index,
+	const char *relative_path
+){
+	const Preload *preload = config->preloaded;
+
+	if(preload == NULL)
+	{
+		return(false);
+	}
+
+	const uint64_t hash = path_hash(*path_prefix_index,relative_path);
+	const size_t mask = preload->capacity - 1;
+
+	for(size_t slot = (size_t)hash & mask; preload->slots[slot] != 0; slot = (slot + 1) & mask)
+	{
+		const PreloadedFile *file = &preload->files[preload->slots[slot] - 1];
+
+		if(file->hash != hash
+			|| file->path_prefix_index != *path_prefix_index
+			|| strcmp(preload->paths + file->path,relative_path) != 0)
+		{
+			continue;
+		}
+
+		if(file->offset != 0)
+		{
+			// The hashing state is only in the DB
+			return(false);
+		}
+
+		dbrow->relative_path_already_in_db = true;
+		dbrow->ID = file->ID;
+		dbrow->saved_offset = 0;
+		dbrow->saved_algorithm = file->algorithm;
+		dbrow->saved_stat.st_size = file->size;
+		dbrow->saved_stat.st_mtim = file->mtim;
+		dbrow->saved_stat.st_ctim = file->ctim;
+
+		return(true);
+	}
+
+	// A new file
+	return(true);
+}
+
+/**
+ *
+ * Totals of preloaded files. False if nothing has been preloaded
+ *
+ */
+bool db_preload_totals
+(
+	size_t *files,
+	size_t *size_in_bytes
+){
+	const Preload *preload = config->preloaded;
+
+	if(preload == NULL)
+	{
+		return(false);
+	}
+
+	*files = preload->count;
+	*size_in_bytes = preload->size_in_bytes;
+
+	return(true);
+}
+
+/**
+ *
+ * Release preloaded metadata
+ *
+ */
+void db_preload_free
+(
+	Preload *preload
+){
+	if(preload == NULL)
+	{
+		return;
+	}
+
+	free(preload->files);
+	free(preload->paths);
+	free(preload->slots);
+	free(preload);
+}
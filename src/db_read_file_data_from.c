@@ -8,40 +8,43 @@
 Return db_read_file_data_from
 (
 	DBrow *dbrow,
-#if 0 // Old multiPATH solution
 	const sqlite3_int64 *path_prefix_index,
-#endif
 	const char *relative_path
 ){
 	/// The status that will be passed to return() before exiting.
 	/// By default, the function worked without errors.
 	Return status = SUCCESS;
 
+	/* Nothing has been saved against a brand new database yet */
+	if(config->bulk_load == true)
+	{
+		return(status);
+	}
+
+	/* Metadata preloaded with --preload */
+	if(db_preload_lookup(dbrow,path_prefix_index,relative_path) == true)
+	{
+		return(status);
+	}
+
 	/* Read from SQL */
-	sqlite3_stmt *select_stmt = NULL;
 	int rc;
 
-	/* Create SQL statement */
-#if 0 // Old multiPATH solution
-	const char *select_sql = "SELECT ID,offset,stat,mdContext FROM files WHERE path_prefix_index = ?1 and relative_path = ?2;";
-#endif
-	const char *select_sql = "SELECT ID,offset,stat,mdContext FROM files WHERE relative_path = ?1;";
-	rc = sqlite3_prepare_v2(config->db, select_sql, -1, &select_stmt, NULL);
-	if(SQLITE_OK != rc) {
-		slog(false,"Can't prepare select statement %s (%i): %s\n", select_sql, rc, sqlite3_errmsg(config->db));
-		status = FAILURE;
-	}
+	/* The statement has been prepared once for all files,
+	 * on the connection of the traversal thread if any */
+	sqlite3_stmt *select_stmt = db_reader_take();
+
+	sqlite3 *db = sqlite3_db_handle(select_stmt);
 
-#if 0 // Old multiPATH solution
 	rc = sqlite3_bind_int64(select_stmt, 1, *path_prefix_index);
 	if(SQLITE_OK != rc) {
-		printf("Error binding value in select (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		slog(false,"Error binding value in select (%i): %s\n", rc, sqlite3_errmsg(db));
 		status = FAILURE;
 	}
-#endif
-	rc = sqlite3_bind_text(select_stmt, 1, relative_path, (int)strlen(relative_path), NULL);
+
+	rc = sqlite3_bind_text(select_stmt, 2, relative_path, (int)strlen(relative_path), NULL);
 	if(SQLITE_OK != rc) {
-		slog(false,"Error binding value in select (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		slog(false,"Error binding value in select (%i): %s\n", rc, sqlite3_errmsg(db));
 		status = FAILURE;
 	}
 
@@ -53,17 +56,21 @@ Return db_read_file_data_from
 		if(get_stat != NULL){
 			memcpy(&dbrow->saved_stat,get_stat,sizeof(struct stat));
 		}
-		const SHA512_Context *get_mdContext = sqlite3_column_blob(select_stmt,3);
-		if(get_mdContext != NULL){
-			memcpy(&dbrow->saved_mdContext,get_mdContext,sizeof(SHA512_Context));
+		int algorithm = sqlite3_column_int(select_stmt,4);
+		dbrow->saved_algorithm = (HashAlgorithm)algorithm;
+		const void *get_mdContext = sqlite3_column_blob(select_stmt,3);
+		// The size of the state depends on the algorithm
+		size_t mdContext_size = (size_t)sqlite3_column_bytes(select_stmt,3);
+		if(get_mdContext != NULL && mdContext_size <= sizeof(HashState)){
+			memcpy(&dbrow->saved_mdContext,get_mdContext,mdContext_size);
 		}
 		dbrow->relative_path_already_in_db = true;
 	}
 	if(SQLITE_DONE != rc) {
-		slog(false,"Select statement didn't finish with DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		slog(false,"Select statement didn't finish with DONE (%i): %s\n", rc, sqlite3_errmsg(db));
 		status = FAILURE;
 	}
-	sqlite3_finalize(select_stmt);
+	db_reader_give_back(select_stmt);
 
 	return(status);
 }
@@ -0,0 +1,142 @@
+#include "precizer.h"
+
+/**
+ *
+ * @file db_reader.c
+ * @brief Lookups of the traversal on a connection of their own
+ * @details While the database writer runs in a thread of its own,
+ * lookups of files the traversal makes against the DB would have
+ * to wait for every batch the writer is busy with. When SQLite has
+ * been built thread-safe (make SQLITE_THREADSAFE=2), the traversal
+ * thread opens a read-only connection of its own, so lookups and
+ * writes go on in parallel. Each file is looked up only once during
+ * a scan, so the lookups never need rows the writer has not
+ * committed yet. A single-threaded SQLite can't be used by two
+ * connections at once, so then lookups share the connection of the
+ * writer under its lock.
+ *
+ */
+
+// Milliseconds a connection waits while the other
+// one holds the lock of the database file
+#define READER_BUSY_TIMEOUT 60000
+
+/// Read-only connection of the traversal thread.
+/// NULL if the connection of the writer is shared
+static sqlite3 *reader = NULL;
+
+/// Lookup of a file prepared against the reader
+static sqlite3_stmt *select_file = NULL;
+
+/**
+ *
+ * Open the read-only connection of the traversal thread
+ * if SQLite could be used from several threads at once
+ *
+ */
+Return db_reader_open(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	// Nothing to look up against a brand new database or
+	// everything is looked up in memory
+	if(sqlite3_threadsafe() == 0 || config->bulk_load == true)
+	{
+		return(status);
+	}
+
+	int rc = sqlite3_open_v2(config->db_file_path, &reader, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL);
+	if(SQLITE_OK != rc)
+	{
+		slog(false,"Can't open database %s for reading (%i): %s\n", config->db_file_name, rc, sqlite3_errmsg(reader));
+		status = FAILURE;
+	}
+
+	const char *sql = "SELECT ID,offset,stat,mdContext,algorithm FROM files WHERE path_prefix_index = ?1 AND relative_path = ?2;";
+
+	if(SUCCESS == status)
+	{
+		rc = sqlite3_prepare_v3(reader, sql, -1, SQLITE_PREPARE_PERSISTENT, &select_file, NULL);
+		if(SQLITE_OK != rc) {
+			slog(false,"Can't prepare statement %s (%i): %s\n", sql, rc, sqlite3_errmsg(reader));
+			status = FAILURE;
+		}
+	}
+
+	if(SUCCESS != status)
+	{
+		db_reader_close();
+		return(status);
+	}
+
+	// A commit of the writer and a lookup
+	// wait for each other instead of failing
+	sqlite3_busy_timeout(reader,READER_BUSY_TIMEOUT);
+	sqlite3_busy_timeout(config->db,READER_BUSY_TIMEOUT);
+
+	slog(true,"Files are looked up on a connection of their own\n");
+
+	return(status);
+}
+
+/**
+ *
+ * Take the statement to look up a file with.
+ * Takes the lock of the writer if the
+ * connection is shared
+ *
+ */
+sqlite3_stmt *db_reader_take(void)
+{
+	if(reader != NULL)
+	{
+		return(select_file);
+	}
+
+	// The connection is shared with the database writer
+	db_writer_lock();
+
+	return(config->statements.select_file);
+}
+
+/**
+ *
+ * Reset the statement after a lookup and
+ * give the shared connection back
+ *
+ */
+void db_reader_give_back
+(
+	sqlite3_stmt *stmt
+){
+	db_release_statement(stmt);
+
+	if(reader == NULL)
+	{
+		db_writer_unlock();
+	}
+}
+
+/**
+ *
+ * Close the read-only connection if any
+ *
+ */
+void db_reader_close(void)
+{
+	if(config->db != NULL)
+	{
+		sqlite3_busy_timeout(config->db,0);
+	}
+
+	sqlite3_finalize(select_file);
+	select_file = NULL;
+
+	if(reader != NULL)
+	{
+		sqlite3_close(reader);
+		reader = NULL;
+	}
+}
@@ -0,0 +1,66 @@
+#include "precizer.h"
+
+/**
+ *
+ * @brief Save the state of a file being hashed against the DB.
+ * @details The offset and the hashing state are written into the
+ * record of the file, so the next run resumes from them. The saved
+ * DB row of the job is brought up to date as well, so the final
+ * result of the job updates the same record later
+ *
+ */
+Return db_save_checkpoint
+(
+	HashJob *job,
+	sqlite3_int64 offset,
+	const HashState *mdContext
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	// Don't do anything in case of --dry_run
+	if(config->dry_run == true)
+	{
+		return(status);
+	}
+
+	DBrow *dbrow = &job->dbrow;
+
+	// Nothing new since the last save
+	if(offset == 0 || (dbrow->relative_path_already_in_db == true
+		&& dbrow->saved_offset == offset && dbrow->saved_algorithm == job->algorithm))
+	{
+		return(status);
+	}
+
+	if(dbrow->relative_path_already_in_db == true)
+	{
+		status = db_update_the_record(&(dbrow->ID),&offset,job->algorithm,job->checksum,&job->stat,mdContext);
+
+	} else {
+
+		status = db_insert_the_record(&job->path_prefix_index,job->relative_path,&offset,job->algorithm,job->checksum,&job->stat,mdContext);
+
+		if(SUCCESS == status)
+		{
+			dbrow->ID = sqlite3_last_insert_rowid(config->db);
+			dbrow->relative_path_already_in_db = true;
+		}
+	}
+
+	if(SUCCESS == status)
+	{
+		dbrow->saved_offset = offset;
+		dbrow->saved_algorithm = job->algorithm;
+		memcpy(&dbrow->saved_stat,&job->stat,sizeof(struct stat));
+
+		// Reflect changes in global
+		config->something_has_been_changed = true;
+
+		// Don't wait for the rest of the batch
+		status = db_transaction_flush();
+	}
+
+	return(status);
+}
@@ -2,75 +2,238 @@
 
 /**
  *
- * Save the directory prefix path into DB
+ * Find the ID of the prefix saved against the table 'paths'.
+ * The ID stays -1 if the prefix has not been saved yet
  *
  */
-Return db_save_prefixes_into(void)
-{
+static Return select_prefix
+(
+	const char *prefix,
+	sqlite3_int64 *path_prefix_index
+){
 	/// The status that will be passed to return() before exiting.
 	/// By default, the function worked without errors.
 	Return status = SUCCESS;
 
-	// Don't do anything
-	if(config->compare == true)
+	*path_prefix_index = -1;
+
+	sqlite3_stmt *select_stmt = NULL;
+
+	const char *select_sql = "SELECT ID FROM paths WHERE prefix = ?1;";
+
+	int rc = sqlite3_prepare_v2(config->db, select_sql, -1, &select_stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare select statement %s (%i): %s\n", select_sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	rc = sqlite3_bind_text(select_stmt, 1, prefix, (int)strlen(prefix), NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Error binding value in select (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	while(SQLITE_ROW == (rc = sqlite3_step(select_stmt)))
 	{
-		return(status);
+		*path_prefix_index = sqlite3_column_int64(select_stmt,0);
+	}
+	if(SQLITE_DONE != rc) {
+		slog(false,"Select statement didn't finish with DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+	sqlite3_finalize(select_stmt);
+
+	return(status);
+}
+
+/**
+ *
+ * Take the first of paths that are saved against the DB but have
+ * not been passed as arguments. The ID stays -1 if there are none
+ *
+ */
+static Return take_missing_prefix
+(
+	sqlite3_int64 *path_prefix_index
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	*path_prefix_index = -1;
+
+	sqlite3_stmt *delete_stmt = NULL;
+
+	const char *delete_sql = "DELETE FROM runtime_paths_id.the_path_id_does_not_exists " \
+	                         "WHERE path_id = (SELECT MIN(path_id) FROM runtime_paths_id.the_path_id_does_not_exists) " \
+	                         "RETURNING path_id;";
+
+	int rc = sqlite3_prepare_v2(config->db, delete_sql, -1, &delete_stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare delete statement %s (%i): %s\n", delete_sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
 	}
 
-	if(config->force == true && config->dry_run == false)
+	while(SQLITE_ROW == (rc = sqlite3_step(delete_stmt)))
 	{
-		/* Delete previous records in the table  */
-		sqlite3_stmt *delete_stmt = NULL;
+		*path_prefix_index = sqlite3_column_int64(delete_stmt,0);
+	}
+	if(SQLITE_DONE != rc) {
+		slog(false,"Delete statement didn't return DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+	sqlite3_finalize(delete_stmt);
+
+	return(status);
+}
+
+/**
+ *
+ * Write the prefix against the table 'paths'. The renewed
+ * path keeps the ID of the replaced one, otherwise a new
+ * ID is taken
+ *
+ */
+static Return save_prefix
+(
+	const char *prefix,
+	sqlite3_int64 *path_prefix_index
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
 
-		const char *delete_sql="DELETE FROM paths WHERE ID IN (SELECT path_id FROM runtime_paths_id.the_path_id_does_not_exists);";
+	sqlite3_stmt *stmt = NULL;
+
+	/* Scan generations never go back, even if
+	 * the path has been renewed with --force */
+	const char *insert_sql = "INSERT INTO paths(prefix,generation) VALUES(?1,(SELECT IFNULL(MAX(generation),0) FROM files));";
+	const char *update_sql = "UPDATE paths SET prefix = ?1 WHERE ID = ?2;";
+
+	const char *sql = *path_prefix_index == -1 ? insert_sql : update_sql;
+
+	int rc = sqlite3_prepare_v2(config->db, sql, -1, &stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare statement %s (%i): %s\n", sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	rc = sqlite3_bind_text(stmt, 1, prefix, (int)strlen(prefix), NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Error binding value (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
 
-		int rc = sqlite3_prepare_v2(config->db, delete_sql, -1, &delete_stmt, NULL);
+	if(*path_prefix_index != -1)
+	{
+		rc = sqlite3_bind_int64(stmt, 2, *path_prefix_index);
 		if(SQLITE_OK != rc) {
-			slog(false,"Can't prepare delete statement (%i): %s\n", rc, sqlite3_errmsg(config->db));
+			slog(false,"Error binding value (%i): %s\n", rc, sqlite3_errmsg(config->db));
 			status = FAILURE;
 		}
+	}
 
-		/* Execute SQL statement */
-		if(sqlite3_step(delete_stmt) != SQLITE_DONE)
-		{
-			slog(false,"Delete statement didn't return DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
-			status = FAILURE;
-		}
-		sqlite3_finalize(delete_stmt);
+	/* Execute SQL statement */
+	if(sqlite3_step(stmt) != SQLITE_DONE)
+	{
+		slog(false,"Statement %s didn't return DONE (%i): %s\n", sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+	sqlite3_finalize(stmt);
+
+	if(SUCCESS == status && *path_prefix_index == -1)
+	{
+		*path_prefix_index = sqlite3_last_insert_rowid(config->db);
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Save the directory prefix path into DB and remember
+ * IDs of all paths passed as arguments. With --force
+ * paths that are not passed anymore are renewed one
+ * by one with new paths in order of their IDs, so
+ * their files are compared with the same records
+ *
+ */
+Return db_save_prefixes_into(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	// Don't do anything
+	if(config->compare == true)
+	{
+		return(status);
 	}
 
-	/* Insert to DB */
-	const char *insert_sql = "INSERT OR IGNORE INTO paths(prefix) VALUES(?1);";
-	sqlite3_stmt *insert_stmt = NULL;
+	size_t count = 0;
+
+	while(config->paths[count] != NULL)
+	{
+		count++;
+	}
 
-	for (int i = 0; config->paths[i]; i++)
+	config->path_prefix_indexes = (sqlite3_int64 *)calloc(count,sizeof(sqlite3_int64));
+	config->path_files = (size_t *)calloc(count,sizeof(size_t));
+	config->path_size_in_bytes = (size_t *)calloc(count,sizeof(size_t));
+	if(config->path_prefix_indexes == NULL
+		|| config->path_files == NULL
+		|| config->path_size_in_bytes == NULL)
 	{
+		slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+		status = FAILURE;
+		return(status);
+	}
 
-		// Remove unnecessary trailing slash at the end of the directory prefix
-		remove_trailing_slash(config->paths[i]);
+	for (size_t i = 0; SUCCESS == status && config->paths[i]; i++)
+	{
+		sqlite3_int64 *path_prefix_index = &config->path_prefix_indexes[i];
 
-		/* Create SQL statement. Prepare to write */
-		int rc = sqlite3_prepare_v2(config->db, insert_sql, -1, &insert_stmt, NULL);
-		if(SQLITE_OK != rc) {
-			slog(false,"Can't prepare insert statement %s (%i): %s\n", insert_sql, rc, sqlite3_errmsg(config->db));
-			status = FAILURE;
+		if(SUCCESS != (status = select_prefix(config->paths[i],path_prefix_index)))
+		{
+			break;
 		}
 
-		rc = sqlite3_bind_text(insert_stmt, 1, config->paths[i], (int)strlen(config->paths[i]), NULL);
-		if(SQLITE_OK != rc) {
-			slog(false,"Error binding value in insert (%i): %s\n", rc, sqlite3_errmsg(config->db));
-			status = FAILURE;
+		if(*path_prefix_index != -1)
+		{
+			// Already saved
+			continue;
 		}
 
-		/* Execute SQL statement */
-		if(sqlite3_step(insert_stmt) != SQLITE_DONE)
+		if(config->force == true)
 		{
-			slog(false,"Insert statement didn't return DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
-			status = FAILURE;
+			if(SUCCESS != (status = take_missing_prefix(path_prefix_index)))
+			{
+				break;
+			}
+
+			if(*path_prefix_index != -1 && config->dry_run == true)
+			{
+				// Files are looked up against the replaced
+				// path, although nothing is renewed
+				continue;
+			}
 		}
 
+		status = save_prefix(config->paths[i],path_prefix_index);
+	}
+
+	if(SUCCESS == status && config->force == true && config->dry_run == false)
+	{
+		/* Delete previous records in the table. Their
+		 * files will be deleted as missing ones */
+		const char *delete_sql = "DELETE FROM paths WHERE ID IN (SELECT path_id FROM runtime_paths_id.the_path_id_does_not_exists);";
+
+		int rc = sqlite3_exec(config->db, delete_sql, NULL, NULL, NULL);
+		if(rc!= SQLITE_OK ){
+			slog(false,"Can't execute %s (%i): %s\n", delete_sql, rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+		}
 	}
-	sqlite3_finalize(insert_stmt);
 
 	return(status);
 }
@@ -0,0 +1,70 @@
+#include "precizer.h"
+
+/**
+ *
+ * @brief Save the number and the total size of files found
+ * under every path passed as an argument
+ * @details Called only after a complete walk, so the next run
+ * with --progress gets its estimate without reading all rows
+ * of the table 'files'. Paths that have not been passed keep
+ * totals of their own last walk. Nothing is saved with --dry-run
+ *
+ */
+Return db_save_totals(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	// Don't do anything
+	if(config->compare == true || config->dry_run == true)
+	{
+		return(status);
+	}
+
+	sqlite3_stmt *update_stmt = NULL;
+	int rc = 0;
+
+	const char *update_sql = "UPDATE paths SET files = ?1, size_in_bytes = ?2 WHERE ID = ?3;";
+
+	rc = sqlite3_prepare_v2(config->db, update_sql, -1, &update_stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare update statement %s (%i): %s\n", update_sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	for(size_t i = 0; SUCCESS == status && config->paths[i] != NULL; i++)
+	{
+		rc = sqlite3_bind_int64(update_stmt, 1, (sqlite3_int64)config->path_files[i]);
+		if(SQLITE_OK != rc) {
+			slog(false,"Error binding value in update (%i): %s\n", rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+		}
+
+		rc = sqlite3_bind_int64(update_stmt, 2, (sqlite3_int64)config->path_size_in_bytes[i]);
+		if(SQLITE_OK != rc) {
+			slog(false,"Error binding value in update (%i): %s\n", rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+		}
+
+		rc = sqlite3_bind_int64(update_stmt, 3, config->path_prefix_indexes[i]);
+		if(SQLITE_OK != rc) {
+			slog(false,"Error binding value in update (%i): %s\n", rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+		}
+
+		if(SUCCESS == status)
+		{
+			/* Execute SQL statement */
+			if(SQLITE_DONE != (rc = sqlite3_step(update_stmt))) {
+				slog(false,"Update statement didn't return DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+				status = FAILURE;
+			}
+		}
+
+		sqlite3_reset(update_stmt);
+	}
+	sqlite3_finalize(update_stmt);
+
+	return(status);
+}
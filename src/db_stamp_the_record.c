@@ -0,0 +1,58 @@
+#include "precizer.h"
+
+/**
+ *
+ * @brief Stamp the record with the current scan generation.
+ * @details The file has been seen by the traversal, although
+ * nothing else in its record needs to be changed. Records that
+ * have not been stamped are candidates for deletion
+ *
+ */
+Return db_stamp_the_record
+(
+	const sqlite3_int64 *ID
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	// Don't do anything in case of --dry_run
+	if(config->dry_run == true)
+	{
+		return(status);
+	}
+
+	int rc = 0;
+
+	/* The statement has been prepared once for all files */
+	sqlite3_stmt *stamp_stmt = config->statements.stamp_file;
+
+	rc = sqlite3_bind_int64(stamp_stmt, 1, config->generation);
+	if(SQLITE_OK != rc) {
+		slog(false,"Error binding value in update (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	rc = sqlite3_bind_int64(stamp_stmt, 2, *ID);
+	if(SQLITE_OK != rc) {
+		slog(false,"Error binding value in update (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	/* Execute SQL statement */
+	if(sqlite3_step(stamp_stmt) != SQLITE_DONE)
+	{
+		slog(false,"Update statement didn't return DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	db_release_statement(stamp_stmt);
+
+	if(SUCCESS == status)
+	{
+		// Rows are committed in batches
+		status = db_transaction_written();
+	}
+
+	return(status);
+}
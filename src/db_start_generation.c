@@ -0,0 +1,66 @@
+#include "precizer.h"
+
+/**
+ *
+ * @brief Start a new scan generation
+ * @details Every file seen by the traversal is stamped with the
+ * number of the current scan. Files of older generations have not
+ * been seen and are candidates for deletion from the database.
+ * The number is only calculated but not saved in case of --dry-run
+ *
+ */
+Return db_start_generation(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	// Don't do anything
+	if(config->compare == true)
+	{
+		return(status);
+	}
+
+	int rc = 0;
+
+	if(config->dry_run == false)
+	{
+		const char *update_sql = "UPDATE paths SET generation = generation + 1;";
+
+		rc = sqlite3_exec(config->db, update_sql, NULL, NULL, NULL);
+		if(rc!= SQLITE_OK ){
+			slog(false,"Can't execute %s (%i): %s\n", update_sql, rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+			return(status);
+		}
+	}
+
+	sqlite3_stmt *select_stmt = NULL;
+
+	const char *select_sql = "SELECT IFNULL(MAX(generation),0) FROM paths;";
+
+	rc = sqlite3_prepare_v2(config->db, select_sql, -1, &select_stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare select statement %s (%i): %s\n", select_sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	while(SQLITE_ROW == (rc = sqlite3_step(select_stmt)))
+	{
+		config->generation = sqlite3_column_int64(select_stmt,0);
+	}
+	if(SQLITE_DONE != rc) {
+		slog(false,"Select statement didn't finish with DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+	sqlite3_finalize(select_stmt);
+
+	if(config->dry_run == true)
+	{
+		config->generation++;
+	}
+
+	slog(true,"Scan generation: %lld\n",(long long int)config->generation);
+
+	return(status);
+}
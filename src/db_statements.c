@@ -0,0 +1,115 @@
+#include "precizer.h"
+
+/**
+ *
+ * @file db_statements.c
+ * @brief SQL statements prepared once for all files
+ * @details Statements that are executed for every file are compiled
+ * only once right after the database has been opened. After every
+ * use a statement is reset and its bindings are cleared, so it
+ * doesn't keep the database busy and doesn't refer to memory of
+ * the file it has been executed for.
+ *
+ */
+
+/**
+ *
+ * Prepare one statement and report an error if any
+ *
+ */
+static Return prepare
+(
+	const char *sql,
+	sqlite3_stmt **stmt
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	int rc = sqlite3_prepare_v3(config->db, sql, -1, SQLITE_PREPARE_PERSISTENT, stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare statement %s (%i): %s\n", sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Prepare statements executed for every file
+ *
+ */
+Return db_prepare_statements(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	// Don't do anything
+	if(config->compare == true)
+	{
+		return(status);
+	}
+
+	Statements *statements = &config->statements;
+
+	if(SUCCESS == status)
+	{
+		status = prepare("SELECT ID,offset,stat,mdContext,algorithm FROM files WHERE path_prefix_index = ?1 AND relative_path = ?2;",&statements->select_file);
+	}
+
+	if(SUCCESS == status)
+	{
+		status = prepare("INSERT INTO files (offset,relative_path,sha512,stat,mdContext,algorithm,generation,path_prefix_index) VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8);",&statements->insert_file);
+	}
+
+	if(SUCCESS == status)
+	{
+		status = prepare("UPDATE files SET offset = ?1, sha512 = ?2, stat = ?3, mdContext = ?4, algorithm = ?6, generation = ?7 WHERE ID = ?5;",&statements->update_file);
+	}
+
+	if(SUCCESS == status)
+	{
+		status = prepare("UPDATE files SET generation = ?1 WHERE ID = ?2;",&statements->stamp_file);
+	}
+
+	if(SUCCESS == status)
+	{
+		slog(true,"SQL statements have been prepared\n");
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Reset the statement after use, so the next
+ * file could be bound to it
+ *
+ */
+void db_release_statement
+(
+	sqlite3_stmt *stmt
+){
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+}
+
+/**
+ *
+ * Finalize all prepared statements. The
+ * database could not be closed before that
+ *
+ */
+void db_finalize_statements(void)
+{
+	Statements *statements = &config->statements;
+
+	sqlite3_finalize(statements->select_file);
+	sqlite3_finalize(statements->insert_file);
+	sqlite3_finalize(statements->update_file);
+	sqlite3_finalize(statements->stamp_file);
+
+	memset(statements,0,sizeof(Statements));
+}
@@ -1,13 +1,216 @@
 #include "precizer.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 /**
  *
- * Check up the integrity of database file
+ * @file db_test.c
+ * @brief Integrity check of database files
+ * @details How thoroughly a database is checked before use is chosen
+ * with --db-check. With --db-check=auto the size, the modification
+ * time and the change counter of the database file are saved into the
+ * file <database>-check after every run that has ended without errors. If the database
+ * has not been touched since then, the quick check is enough. A crash
+ * or any write from outside changes the file, so then it is checked
+ * in full, and anyway every FULL_CHECK_EVERY runs.
  *
  */
-Return db_test
+
+// Every that many runs the database is checked in full
+#define FULL_CHECK_EVERY 10
+
+// Suffix of the file with the state of the database after the last run
+static const char *check_suffix = "-check";
+
+// The main database has been checked up during this run
+static bool main_db_checked = false;
+
+/**
+ *
+ * Compose the path of the file with the state of the database.
+ * The path should be released by the caller
+ *
+ */
+static char *check_path
+(
+	const char *db_file_path
+){
+	char *path = (char *)malloc(strlen(db_file_path) + strlen(check_suffix) + 1);
+
+	if(path != NULL)
+	{
+		strcpy(path,db_file_path);
+		strcat(path,check_suffix);
+	}
+
+	return(path);
+}
+
+/**
+ *
+ * Read the file change counter from the header of a database.
+ * Every commit in rollback journal modes increments it, so it
+ * catches writes the modification time with its coarse
+ * granularity could miss. Zero if it can't be read
+ *
+ */
+static unsigned long int change_counter
 (
 	const char *db_file_path
+){
+	unsigned char bytes[4] = {0};
+
+	int fd = open(db_file_path,O_RDONLY);
+
+	if(fd >= 0)
+	{
+		// Big-endian at offset 24 of the header
+		if(pread(fd,bytes,sizeof(bytes),24) != (ssize_t)sizeof(bytes))
+		{
+			memset(bytes,0,sizeof(bytes));
+		}
+		close(fd);
+	}
+
+	return(((unsigned long int)bytes[0] << 24)
+		| ((unsigned long int)bytes[1] << 16)
+		| ((unsigned long int)bytes[2] << 8)
+		| (unsigned long int)bytes[3]);
+}
+
+/**
+ *
+ * Choose whether the database is checked in full with
+ * --db-check=auto. True if the database file differs from the
+ * state saved after the last run, there is no saved state or
+ * it is time for the regular full check
+ *
+ */
+static bool full_check_is_due
+(
+	const char *db_file_path,
+	unsigned int *runs
+){
+
+	struct stat stat_buf;
+
+	if(stat(db_file_path,&stat_buf) != 0)
+	{
+		return(true);
+	}
+
+	char *path = check_path(db_file_path);
+
+	if(path == NULL)
+	{
+		return(true);
+	}
+
+	FILE *file = fopen(path,"r");
+
+	free(path);
+
+	if(file == NULL)
+	{
+		slog(true,"The database %s has no saved state and will be checked in full\n",db_file_path);
+		return(true);
+	}
+
+	long long int size = 0;
+	long long int sec = 0;
+	long int nsec = 0;
+	unsigned long int counter = 0;
+	unsigned int saved_runs = 0;
+
+	int fields = fscanf(file,"%lld %lld %ld %lu %u",&size,&sec,&nsec,&counter,&saved_runs);
+
+	fclose(file);
+
+	if(fields != 5
+		|| size != (long long int)stat_buf.st_size
+		|| sec != (long long int)stat_buf.st_mtim.tv_sec
+		|| nsec != stat_buf.st_mtim.tv_nsec
+		|| counter != change_counter(db_file_path))
+	{
+		slog(true,"The database %s has been changed since the last run and will be checked in full\n",db_file_path);
+		return(true);
+	}
+
+	if(saved_runs + 1 >= FULL_CHECK_EVERY)
+	{
+		slog(true,"The database %s has been checked quickly %u times in a row and will be checked in full\n",db_file_path,saved_runs);
+		return(true);
+	}
+
+	*runs = saved_runs + 1;
+
+	return(false);
+}
+
+/**
+ *
+ * Choose whether the database should be checked in full according
+ * to --db-check. The number of runs since the last full check is
+ * passed back with runs if it is not NULL. Should be called before
+ * the database file is opened for writing, which changes the file
+ *
+ */
+bool db_test_in_full
+(
+	const char *db_file_path,
+	unsigned int *runs
+){
+	unsigned int checked_quickly = 0;
+
+	bool full_check = config->db_check == DB_CHECK_FULL;
+
+	if(config->db_check == DB_CHECK_AUTO && strcmp(db_file_path,":memory:") != 0)
+	{
+		full_check = full_check_is_due(db_file_path,&checked_quickly);
+	}
+
+	if(runs != NULL)
+	{
+		*runs = checked_quickly;
+	}
+
+	return(full_check);
+}
+
+/**
+ *
+ * Look at the database file before it is opened and choose
+ * how thoroughly it will be checked up by db_test()
+ *
+ */
+Return db_test_choose(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	// Don't do anything
+	if(config->compare == true)
+	{
+		return(status);
+	}
+
+	config->db_check_full = db_test_in_full(config->db_file_path,&config->db_check_runs);
+
+	return(status);
+}
+
+/**
+ *
+ * Check up the integrity of database file in full
+ * or quickly, as chosen by db_test_in_full()
+ *
+ */
+Return db_test
+(
+	const char *db_file_path,
+	bool full_check
 ){
 	/// The status that will be passed to return() before exiting.
 	/// By default, the function worked without errors.
@@ -19,6 +222,12 @@ Return db_test
 		return(status);
 	}
 
+	if(config->db_check == DB_CHECK_OFF)
+	{
+		slog(true,"The integrity check of %s is skipped\n",db_file_path);
+		return(status);
+	}
+
 	sqlite3_stmt *select_stmt = NULL;
 	sqlite3 *db = NULL;
 	int rc = 0;
@@ -31,7 +240,12 @@ Return db_test
 	strcpy(tmp,db_file_path);
 	const char *db_file_name = basename(tmp);
 
-	slog(false,"Starting of database file %s integrity check...\n",db_file_name);
+	if(full_check == true)
+	{
+		slog(false,"Starting of database file %s integrity check...\n",db_file_name);
+	} else {
+		slog(false,"Starting of database file %s quick integrity check...\n",db_file_name);
+	}
 
 	int sqlite_open_flag = SQLITE_OPEN_READONLY;
 
@@ -42,7 +256,8 @@ Return db_test
 		status = FAILURE;
 	}
 
-	const char *sql = "PRAGMA integrity_check";
+	// The quick check skips matching of indexes against tables
+	const char *sql = full_check == true ? "PRAGMA integrity_check" : "PRAGMA quick_check";
 
 	rc = sqlite3_prepare_v2(db, sql, -1, &select_stmt, NULL);
 	if(SQLITE_OK != rc) {
@@ -76,5 +291,88 @@ Return db_test
 
 	free(tmp);
 
+	if(SUCCESS == status && strcmp(db_file_path,config->db_file_path) == 0)
+	{
+		main_db_checked = true;
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Close the database and save the size, the modification time
+ * and the change counter of its file, so the next run with --db-check=auto could make
+ * sure that nobody has touched it since then. Called only when
+ * the run has ended without errors. Nothing is saved if a due
+ * full check has not been made, so it is not put off, and
+ * nothing is written with --dry-run
+ *
+ */
+Return db_test_save_state(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	// Don't do anything
+	if(config->db_check != DB_CHECK_AUTO
+		|| config->compare == true
+		|| config->dry_run == true
+		|| strcmp(config->db_file_path,":memory:") == 0
+		|| (config->db_check_full == true && main_db_checked == false))
+	{
+		return(status);
+	}
+
+	/* The file is changed for the last time when the
+	 * DB is closed, for example by a WAL checkpoint */
+	db_finalize_statements();
+	sqlite3_close(config->db);
+	config->db = NULL;
+
+	struct stat stat_buf;
+
+	if(stat(config->db_file_path,&stat_buf) != 0)
+	{
+		slog(false,"Can't stat %s: %s\n",config->db_file_path,strerror(errno));
+		status = FAILURE;
+		return(status);
+	}
+
+	char *path = check_path(config->db_file_path);
+
+	if(path == NULL)
+	{
+		slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+		status = FAILURE;
+		return(status);
+	}
+
+	FILE *file = fopen(path,"w");
+
+	if(file == NULL)
+	{
+		slog(false,"Can't save the state of the database into %s: %s\n",path,strerror(errno));
+		status = FAILURE;
+
+	} else {
+
+		fprintf(file,"%lld %lld %ld %lu %u\n",
+			(long long int)stat_buf.st_size,
+			(long long int)stat_buf.st_mtim.tv_sec,
+			stat_buf.st_mtim.tv_nsec,
+			change_counter(config->db_file_path),
+			config->db_check_runs);
+
+		if(fclose(file) != 0)
+		{
+			slog(false,"Can't save the state of the database into %s: %s\n",path,strerror(errno));
+			status = FAILURE;
+		}
+	}
+
+	free(path);
+
 	return(status);
 }
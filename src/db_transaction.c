@@ -0,0 +1,184 @@
+#include "precizer.h"
+
+/**
+ *
+ * @file db_transaction.c
+ * @brief Writes against the DB grouped into transactions
+ * @details Without an explicit transaction every written row is a
+ * transaction of its own and costs at least one write to the
+ * database file. Rows are grouped into one transaction that is
+ * committed every --batch-size rows or every second, whichever
+ * comes first, so each commit writes many rows at once. While a
+ * huge file is hashed nothing else is written, so rows written
+ * before it are committed by time from db_transaction_commit_due().
+ * The last transaction is committed at the end, also on interruption.
+ *
+ */
+
+typedef struct {
+
+	/// A transaction has been begun and not committed yet
+	bool open;
+
+	/// Rows written in the current transaction
+	size_t rows;
+
+	/// When the current transaction has been begun, ms
+	long long int started;
+
+} Transaction;
+
+static Transaction transaction;
+
+/**
+ *
+ * Execute a statement that controls transactions
+ *
+ */
+static Return execute
+(
+	const char *sql
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	int rc = sqlite3_exec(config->db, sql, NULL, NULL, NULL);
+	if(rc!= SQLITE_OK ){
+		slog(false,"Can't execute %s (%i): %s\n", sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Begin a transaction for the rows written next
+ *
+ */
+Return db_transaction_begin(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	// Don't do anything in case of --dry_run
+	if(config->dry_run == true || transaction.open == true)
+	{
+		return(status);
+	}
+
+	if(SUCCESS == (status = execute("BEGIN TRANSACTION;")))
+	{
+		transaction.open = true;
+		transaction.rows = 0;
+		transaction.started = cur_time_ms();
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Commit the current transaction if any
+ *
+ */
+Return db_transaction_end(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	if(transaction.open == false)
+	{
+		return(status);
+	}
+
+	transaction.open = false;
+
+	status = execute("COMMIT;");
+
+	return(status);
+}
+
+/**
+ *
+ * Commit all rows written so far right now and go on
+ * in a new transaction. For example, a checkpoint should
+ * reach the database file as soon as possible
+ *
+ */
+Return db_transaction_flush(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	if(transaction.open == false)
+	{
+		return(status);
+	}
+
+	if(SUCCESS == (status = db_transaction_end()))
+	{
+		status = db_transaction_begin();
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Count a written row. The transaction is committed
+ * when it is big or old enough
+ *
+ */
+Return db_transaction_written(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	if(transaction.open == false)
+	{
+		return(status);
+	}
+
+	transaction.rows++;
+
+	if(transaction.rows >= config->batch_size
+		|| cur_time_ms() - transaction.started >= TRANSACTION_INTERVAL_MS)
+	{
+		status = db_transaction_flush();
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Commit the current transaction if it holds rows and is
+ * old enough, even if nothing else is written. So rows
+ * written before a huge file survive a crash while the
+ * file is being hashed
+ *
+ */
+Return db_transaction_commit_due(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	if(transaction.open == false || transaction.rows == 0)
+	{
+		return(status);
+	}
+
+	if(cur_time_ms() - transaction.started >= TRANSACTION_INTERVAL_MS)
+	{
+		status = db_transaction_flush();
+	}
+
+	return(status);
+}
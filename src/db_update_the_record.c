@@ -11,9 +11,10 @@ Return db_update_the_record
 (
 	const sqlite3_int64 *ID,
 	const sqlite3_int64 *offset,
-	const unsigned char *sha512,
+	HashAlgorithm algorithm,
+	const unsigned char *checksum,
 	const struct stat *stat,
-	const SHA512_Context *mdContext
+	const HashState *mdContext
 ){
 	/// The status that will be passed to return() before exiting.
 	/// By default, the function worked without errors.
@@ -28,15 +29,8 @@ Return db_update_the_record
 	/* Update record in DB */
 	int rc = 0;
 
-	sqlite3_stmt *update_stmt = NULL;
-	const char *update_sql = "UPDATE files SET offset = ?1, sha512 = ?2, stat = ?3, mdContext = ?4 WHERE ID = ?5;";
-
-	/* Create SQL statement. Prepare to write */
-	rc = sqlite3_prepare_v2(config->db, update_sql, -1, &update_stmt, NULL);
-	if(SQLITE_OK != rc) {
-		slog(false,"Can't prepare update statement %s (%i): %s\n", update_sql, rc, sqlite3_errmsg(config->db));
-		status = FAILURE;
-	}
+	/* The statement has been prepared once for all files */
+	sqlite3_stmt *update_stmt = config->statements.update_file;
 
 	if(*offset == 0){
 		rc = sqlite3_bind_null(update_stmt, 1);
@@ -49,7 +43,7 @@ Return db_update_the_record
 	}
 
 	if(*offset == 0){
-		rc = sqlite3_bind_blob(update_stmt, 2, sha512, SHA512_DIGEST_LENGTH, NULL);
+		rc = sqlite3_bind_blob(update_stmt, 2, checksum, (int)hash_digest_length(algorithm), NULL);
 	} else {
 		rc = sqlite3_bind_null(update_stmt, 2);
 	}
@@ -67,7 +61,7 @@ Return db_update_the_record
 	if(*offset == 0){
 		rc = sqlite3_bind_null(update_stmt, 4);
 	} else {
-		rc = sqlite3_bind_blob(update_stmt, 4, mdContext, sizeof(SHA512_Context), NULL);
+		rc = sqlite3_bind_blob(update_stmt, 4, mdContext, (int)hash_context_size(algorithm), NULL);
 	}
 	if(SQLITE_OK != rc) {
 		slog(false,"Error binding value in update (%i): %s\n", rc, sqlite3_errmsg(config->db));
@@ -80,6 +74,19 @@ Return db_update_the_record
 		status = FAILURE;
 	}
 
+	rc = sqlite3_bind_int(update_stmt, 6, (int)algorithm);
+	if(SQLITE_OK != rc) {
+		slog(false,"Error binding value in update (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	// The file has been seen by the current scan
+	rc = sqlite3_bind_int64(update_stmt, 7, config->generation);
+	if(SQLITE_OK != rc) {
+		slog(false,"Error binding value in update (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
 	/* Execute SQL statement */
 	if(sqlite3_step(update_stmt) != SQLITE_DONE)
 	{
@@ -87,7 +94,13 @@ Return db_update_the_record
 		status = FAILURE;
 	}
 
-	sqlite3_finalize(update_stmt);
+	db_release_statement(update_stmt);
+
+	if(SUCCESS == status)
+	{
+		// Rows are committed in batches
+		status = db_transaction_written();
+	}
 
 	return(status);
 }
@@ -0,0 +1,329 @@
+#include "precizer.h"
+
+/**
+ *
+ * True if the column exists in the table.
+ * Errors are reported as FAILURE
+ *
+ */
+static Return column_exists
+(
+	const char *table,
+	const char *column,
+	bool *exists
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	sqlite3_stmt *select_stmt = NULL;
+	int rc = 0;
+
+	*exists = false;
+
+	const char *select_sql = "SELECT COUNT(*) FROM pragma_table_info(?1) WHERE name = ?2;";
+
+	rc = sqlite3_prepare_v2(config->db, select_sql, -1, &select_stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare select statement %s (%i): %s\n", select_sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	rc = sqlite3_bind_text(select_stmt, 1, table, (int)strlen(table), NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Error binding value in select (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	rc = sqlite3_bind_text(select_stmt, 2, column, (int)strlen(column), NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Error binding value in select (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	while(SQLITE_ROW == (rc = sqlite3_step(select_stmt)))
+	{
+		if(sqlite3_column_int64(select_stmt,0) > 0)
+		{
+			*exists = true;
+		}
+	}
+	if(SQLITE_DONE != rc) {
+		slog(false,"Select statement didn't finish with DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+	sqlite3_finalize(select_stmt);
+
+	return(status);
+}
+
+/**
+ *
+ * A database created by a previous version can't be
+ * used with --dry-run, because it should be upgraded
+ * first and nothing is written against the DB then
+ *
+ */
+static Return upgrade_is_not_allowed(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function failed.
+	Return status = FAILURE;
+
+	slog(false,"The database %s has been created by a previous version of the program and should be upgraded, which can't be done with --dry-run. Run the program once without --dry-run\n",config->db_file_name);
+
+	return(status);
+}
+
+/**
+ *
+ * Add the column if it is absent
+ *
+ */
+static Return add_column
+(
+	const char *table,
+	const char *column,
+	const char *alter_sql,
+	const char *message
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	bool exists = false;
+
+	if(SUCCESS == (status = column_exists(table,column,&exists)) && exists == false)
+	{
+		if(config->dry_run == true)
+		{
+			status = upgrade_is_not_allowed();
+			return(status);
+		}
+
+		int rc = sqlite3_exec(config->db, alter_sql, NULL, NULL, NULL);
+		if(rc!= SQLITE_OK ){
+			slog(false,"Can't execute (%i): %s\n", rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+		} else {
+			slog(true,"%s",message);
+		}
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Databases of previous versions keep every relative path
+ * only once and all files belong to the only path saved
+ * against the table 'paths'. The table 'files' is rebuilt,
+ * because the unique relative path could not be dropped
+ *
+ */
+static Return add_path_prefix_index(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	bool exists = false;
+
+	if(SUCCESS != (status = column_exists("files","path_prefix_index",&exists)) || exists == true)
+	{
+		return(status);
+	}
+
+	if(config->dry_run == true)
+	{
+		status = upgrade_is_not_allowed();
+		return(status);
+	}
+
+	const char *upgrade_sql = "BEGIN TRANSACTION;" \
+	                          "ALTER TABLE files RENAME TO files_previous;" \
+	                          "CREATE TABLE files("  \
+	                          "ID INTEGER PRIMARY KEY NOT NULL," \
+	                          "offset INTEGER DEFAULT NULL," \
+	                          "path_prefix_index INTEGER NOT NULL," \
+	                          "relative_path TEXT NOT NULL," \
+	                          "sha512 BLOB DEFAULT NULL," \
+	                          "stat BLOB DEFAULT NULL," \
+	                          "mdContext BLOB DEFAULT NULL," \
+	                          "algorithm INTEGER NOT NULL DEFAULT 1," \
+	                          "generation INTEGER NOT NULL DEFAULT 0);" \
+	                          "INSERT INTO files (ID,offset,path_prefix_index,relative_path,sha512,stat,mdContext,algorithm,generation) " \
+	                          "SELECT ID,offset,(SELECT IFNULL(MIN(ID),1) FROM paths),relative_path,sha512,stat,mdContext,algorithm,generation FROM files_previous;" \
+	                          "DROP TABLE files_previous;" \
+	                          "CREATE UNIQUE INDEX full_path ON files (path_prefix_index, relative_path);" \
+	                          "COMMIT;";
+
+	int rc = sqlite3_exec(config->db, upgrade_sql, NULL, NULL, NULL);
+	if(rc!= SQLITE_OK ){
+		slog(false,"Can't execute (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		sqlite3_exec(config->db, "ROLLBACK;", NULL, NULL, NULL);
+		status = FAILURE;
+	} else {
+		slog(true,"The database has been upgraded. Files refer to paths they have been found in\n");
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Previous versions saved paths exactly as they had been passed,
+ * like "./dir/". Now they are normalized before they are saved,
+ * so the saved ones are normalized the same way to still match.
+ * A path that would become equal to another saved path is kept
+ * as it is, because files of both are saved against the DB
+ *
+ */
+static Return normalize_prefixes(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	sqlite3_stmt *select_stmt = NULL;
+	sqlite3_stmt *update_stmt = NULL;
+
+	const char *select_sql = "SELECT ID,prefix FROM paths;";
+	const char *update_sql = "UPDATE OR IGNORE paths SET prefix = ?1 WHERE ID = ?2;";
+
+	int rc = sqlite3_prepare_v2(config->db, select_sql, -1, &select_stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare select statement %s (%i): %s\n", select_sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	if(SUCCESS == status)
+	{
+		rc = sqlite3_prepare_v2(config->db, update_sql, -1, &update_stmt, NULL);
+		if(SQLITE_OK != rc) {
+			slog(false,"Can't prepare update statement %s (%i): %s\n", update_sql, rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+		}
+	}
+
+	while(SUCCESS == status && SQLITE_ROW == (rc = sqlite3_step(select_stmt)))
+	{
+		sqlite3_int64 ID = sqlite3_column_int64(select_stmt,0);
+		const char *prefix = (const char *)sqlite3_column_text(select_stmt,1);
+
+		char *normalized = strdup(prefix);
+		if(normalized == NULL)
+		{
+			slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+			status = FAILURE;
+			break;
+		}
+
+		normalize_path(normalized);
+
+		if(strcmp(normalized,prefix) != 0 && config->dry_run == true)
+		{
+			free(normalized);
+			status = upgrade_is_not_allowed();
+			break;
+		}
+
+		if(strcmp(normalized,prefix) != 0)
+		{
+			sqlite3_bind_text(update_stmt, 1, normalized, (int)strlen(normalized), NULL);
+			sqlite3_bind_int64(update_stmt, 2, ID);
+
+			if(SQLITE_DONE != (rc = sqlite3_step(update_stmt)))
+			{
+				slog(false,"Update statement didn't return DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+				status = FAILURE;
+
+			} else if(sqlite3_changes(config->db) == 0)
+			{
+				slog(false,"The saved path %s is the same as %s, which has been saved as well\n",prefix,normalized);
+			} else {
+				slog(true,"The database has been upgraded. The saved path %s is now %s\n",prefix,normalized);
+			}
+
+			sqlite3_reset(update_stmt);
+			sqlite3_clear_bindings(update_stmt);
+		}
+
+		free(normalized);
+	}
+	if(SUCCESS == status && SQLITE_DONE != rc) {
+		slog(false,"Select statement didn't finish with DONE (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	sqlite3_finalize(update_stmt);
+	sqlite3_finalize(select_stmt);
+
+	return(status);
+}
+
+/**
+ *
+ * @brief Bring the schema of a database created by
+ * a previous version of the program up to date
+ * @details The column 'algorithm' is added if absent.
+ * All checksums saved before it appeared are SHA512.
+ * Columns 'generation' are added if absent. Files of
+ * such databases are treated as seen by no scan yet.
+ * Files get the column 'path_prefix_index'. Saved
+ * paths are normalized at last
+ *
+ */
+Return db_upgrade(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	if(SUCCESS == status)
+	{
+		status = add_column("files","algorithm",
+			"ALTER TABLE files ADD COLUMN algorithm INTEGER NOT NULL DEFAULT 1;",
+			"The database has been upgraded. All checksums saved against it are SHA512\n");
+	}
+
+	if(SUCCESS == status)
+	{
+		status = add_column("files","generation",
+			"ALTER TABLE files ADD COLUMN generation INTEGER NOT NULL DEFAULT 0;",
+			"The database has been upgraded with scan generations of files\n");
+	}
+
+	if(SUCCESS == status)
+	{
+		status = add_column("paths","generation",
+			"ALTER TABLE paths ADD COLUMN generation INTEGER NOT NULL DEFAULT 0;",
+			"The database has been upgraded with scan generations of paths\n");
+	}
+
+	if(SUCCESS == status)
+	{
+		status = add_column("paths","files",
+			"ALTER TABLE paths ADD COLUMN files INTEGER DEFAULT NULL;",
+			"The database has been upgraded with numbers of files of paths\n");
+	}
+
+	if(SUCCESS == status)
+	{
+		status = add_column("paths","size_in_bytes",
+			"ALTER TABLE paths ADD COLUMN size_in_bytes INTEGER DEFAULT NULL;",
+			"The database has been upgraded with total sizes of files of paths\n");
+	}
+
+	if(SUCCESS == status)
+	{
+		status = add_path_prefix_index();
+	}
+
+	if(SUCCESS == status)
+	{
+		status = normalize_prefixes();
+	}
+
+	return(status);
+}
@@ -1,9 +1,139 @@
 #include "precizer.h"
 
+// Vacuum only when free pages take at
+// least that many percents of the file
+#define VACUUM_FREE_PERCENT 10
+
+// Free pages given back to the file system at once
+#define VACUUM_STEP_PAGES 2048
+
+// Incremental vacuuming stops after that many ms. The
+// rest of free pages are given back by the next runs
+#define VACUUM_TIME_BUDGET_MS 5000LL
+
+/**
+ *
+ * Read a single number returned by a pragma
+ *
+ */
+static Return pragma_value
+(
+	const char *sql,
+	sqlite3_int64 *value
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	sqlite3_stmt *select_stmt = NULL;
+
+	int rc = sqlite3_prepare_v2(config->db, sql, -1, &select_stmt, NULL);
+	if(SQLITE_OK != rc) {
+		slog(false,"Can't prepare select statement %s (%i): %s\n", sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	while(SUCCESS == status && SQLITE_ROW == (rc = sqlite3_step(select_stmt)))
+	{
+		*value = sqlite3_column_int64(select_stmt,0);
+	}
+	if(SUCCESS == status && SQLITE_DONE != rc) {
+		slog(false,"Select statement %s didn't finish with DONE (%i): %s\n", sql, rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+	sqlite3_finalize(select_stmt);
+
+	return(status);
+}
+
 /**
  *
- * The VACUUM command rebuilds the database file,
- * repacking it into a minimal amount of disk space.
+ * Give free pages back to the file system step by step
+ * until there are none or the time is over. Every step
+ * is short, so the interruption is checked between them
+ *
+ */
+static Return incremental_vacuum(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	char sql[64];
+
+	snprintf(sql,sizeof(sql),"PRAGMA incremental_vacuum(%d);",VACUUM_STEP_PAGES);
+
+	long long int started = cur_time_ms();
+
+	sqlite3_int64 freelist_count = 0;
+
+	do {
+		int rc = sqlite3_exec(config->db, sql, NULL, NULL, NULL);
+		if(rc!= SQLITE_OK ){
+			slog(false,"Can't execute %s (%i): %s\n", sql, rc, sqlite3_errmsg(config->db));
+			status = FAILURE;
+			break;
+		}
+
+		if(SUCCESS != (status = pragma_value("PRAGMA freelist_count;",&freelist_count)))
+		{
+			break;
+		}
+
+	} while(freelist_count > 0
+		&& global_interrupt_flag == false
+		&& cur_time_ms() - started < VACUUM_TIME_BUDGET_MS);
+
+	if(SUCCESS == status && freelist_count > 0)
+	{
+		slog(false,"Vacuuming has been stopped, %lld free pages are left for the next run\n",(long long int)freelist_count);
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Rebuild the whole file once and switch it to incremental
+ * vacuuming. The main database is written only at the very
+ * end, so the long rebuild is stopped with Ctrl+C and the
+ * database stays as it was
+ *
+ */
+static Return full_vacuum(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	const char *sql = "PRAGMA auto_vacuum = INCREMENTAL;" \
+	                  "VACUUM;";
+
+	global_interruptible_db = config->db;
+
+	int rc = sqlite3_exec(config->db, sql, NULL, NULL, NULL);
+
+	global_interruptible_db = NULL;
+
+	if(rc == SQLITE_INTERRUPT)
+	{
+		slog(false,"Vacuuming has been interrupted\n");
+
+	} else if(rc!= SQLITE_OK ){
+		slog(false,"Can't execute (%i): %s\n", rc, sqlite3_errmsg(config->db));
+		status = FAILURE;
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Give space of deleted files back to the file system when
+ * free pages take a noticeable part of the database file.
+ * Databases are created with auto_vacuum=INCREMENTAL, so only
+ * free pages are moved and the file is not rewritten. Databases
+ * created by previous versions are rebuilt once by VACUUM
  *
  */
 Return db_vacuum(void)
@@ -13,7 +143,7 @@ Return db_vacuum(void)
 	Return status = SUCCESS;
 
 	// Don't do anything
-	if(config->compare == true)
+	if(config->compare == true || config->dry_run == true)
 	{
 		return(status);
 	}
@@ -24,20 +154,42 @@ Return db_vacuum(void)
 		return(status);
 	}
 
-	slog(false,"Start vacuuming...\n");
-
-	int rc;
-
-	/* Create SQL statement */
-	const char *sql = "pragma optimize;" \
-	                  "VACUUM;";
-
-	/* Execute SQL statement */
-	rc = sqlite3_exec(config->db, sql, NULL, NULL, NULL);
+	int rc = sqlite3_exec(config->db, "PRAGMA optimize;", NULL, NULL, NULL);
 	if(rc!= SQLITE_OK ){
 		slog(false,"Can't execute (%i): %s\n", rc, sqlite3_errmsg(config->db));
 		status = FAILURE;
+		return(status);
+	}
+
+	sqlite3_int64 page_count = 0;
+	sqlite3_int64 freelist_count = 0;
+	sqlite3_int64 auto_vacuum = 0;
+
+	if(SUCCESS != (status = pragma_value("PRAGMA page_count;",&page_count))
+		|| SUCCESS != (status = pragma_value("PRAGMA freelist_count;",&freelist_count))
+		|| SUCCESS != (status = pragma_value("PRAGMA auto_vacuum;",&auto_vacuum)))
+	{
+		return(status);
+	}
+
+	if(freelist_count * 100 < page_count * VACUUM_FREE_PERCENT)
+	{
+		slog(true,"Vacuuming is not needed, %lld of %lld pages are free\n",(long long int)freelist_count,(long long int)page_count);
+		return(status);
+	}
+
+	slog(false,"Start vacuuming...\n");
+
+	// 2 is INCREMENTAL
+	if(auto_vacuum == 2)
+	{
+		status = incremental_vacuum();
 	} else {
+		status = full_vacuum();
+	}
+
+	if(SUCCESS == status && global_interrupt_flag == false)
+	{
 		slog(false,"The database has been vacuumed\n");
 	}
 
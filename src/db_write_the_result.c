@@ -0,0 +1,75 @@
+#include "precizer.h"
+
+/**
+ *
+ * @brief Save the result of hashing against the DB.
+ * @details Decide whether the record of the file should be
+ * updated or a brand new record should be inserted and
+ * write the checksum, metadata and hashing state of the file
+ *
+ */
+Return db_write_the_result
+(
+	const HashJob *job
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	const DBrow *dbrow = &job->dbrow;
+
+	bool update_db = false;
+
+	if (dbrow->relative_path_already_in_db == true)
+	{
+		if(job->offset > dbrow->saved_offset)
+		{
+			// Update DB record
+			update_db = true;
+
+		} else if(dbrow->saved_offset > 0 && job->offset == 0)
+		{
+			// Update DB record
+			update_db = true;
+
+		} else if(job->metadata_of_scanned_and_saved_files != IDENTICAL)
+		{
+			// Update DB record
+			update_db = true;
+
+		} else if(job->algorithm != dbrow->saved_algorithm)
+		{
+			// Rehashed with another algorithm
+			update_db = true;
+		}
+	}
+
+	if(dbrow->relative_path_already_in_db == true && update_db == false)
+	{
+		// The record already keeps exactly this state. For example,
+		// the file has been interrupted again right after a checkpoint
+		status = db_stamp_the_record(&dbrow->ID);
+		return(status);
+	}
+
+	/* In any other case NO need to update DB record just insert the record */
+	if(update_db == true)
+	{
+		/* Update record in DB */
+		if(SUCCESS == (status = db_update_the_record(&(dbrow->ID),&job->offset,job->algorithm,job->checksum,&job->stat,&job->mdContext)))
+		{
+			// Reflect changes in global
+			config->something_has_been_changed = true;
+		}
+
+	} else {
+		/* Insert to DB */
+		if(SUCCESS == (status = db_insert_the_record(&job->path_prefix_index,job->relative_path,&job->offset,job->algorithm,job->checksum,&job->stat,&job->mdContext)))
+		{
+			// Reflect changes in global
+			config->something_has_been_changed = true;
+		}
+	}
+
+	return(status);
+}
@@ -0,0 +1,485 @@
+#include "precizer.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+
+/**
+ *
+ * @file db_writer.c
+ * @brief Results of hashing written against the DB by a thread of its own
+ * @details The traversal loop hands finished jobs and marks of unchanged
+ * files over to the writer and goes on without waiting for the database.
+ * The writer drains them in order and writes them in transactions of
+ * --batch-size rows, so maintenance of the B-tree never stops the walk
+ * or the hashing. The queue is bounded and the traversal waits when it
+ * is full, so memory usage stays bounded when the disk of the database
+ * is slower than the hashing. Lookups of the traversal thread are made
+ * on a connection of their own if SQLite is thread-safe (see
+ * db_reader.c), otherwise they are serialized with the writer by a lock.
+ * With a single CPU the thread could only take turns with the
+ * traversal, so everything is written right away instead.
+ *
+ */
+
+// Writes that could wait for the writer. Queued jobs
+// are big enough, so the queue is kept short to stay
+// in the CPU cache
+#define WRITER_QUEUE_CAPACITY 256
+
+// Writes collected before the writer is woken up,
+// so it doesn't take turns with the traversal on
+// every single file
+#define WRITER_BATCH 32
+
+/* One write waiting for the writer */
+typedef struct Write {
+
+	/// The job to be saved. NULL if only
+	/// the record should be stamped
+	HashJob *job;
+
+	/// ID of the record to be stamped
+	sqlite3_int64 ID;
+
+	/// Next write in the queue
+	struct Write *next;
+
+} Write;
+
+typedef struct {
+
+	/// Protects all fields below
+	pthread_mutex_t mutex;
+
+	/// Signals that a write has been added to the queue
+	/// or no more writes will be added
+	pthread_cond_t write_added;
+
+	/// Signals that a write has been taken from the queue
+	pthread_cond_t write_taken;
+
+	/// Queue of writes
+	Write *head;
+	Write *tail;
+
+	/// Writes in the queue
+	size_t count;
+
+	/// Something in the queue should be written without
+	/// waiting for a whole batch, like a checkpoint
+	bool flush;
+
+	/// No more writes will be added
+	bool shutdown;
+
+	/// The first failure of the writer. Everything
+	/// after it is released without writing
+	Return status;
+
+	/// The writer thread
+	pthread_t thread;
+
+	/// The writer has been started
+	bool started;
+
+} Writer;
+
+static Writer writer;
+
+/// Serializes all users of the database connection
+static pthread_mutex_t connection = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ *
+ * Save a finished job against the DB and release it.
+ * Jobs that have never been started because of
+ * interruption are just released. Checkpoints of
+ * jobs still being hashed are saved as well
+ *
+ */
+static Return write_the_result
+(
+	HashJob *job
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	if(job->origin != NULL)
+	{
+		/* The state of a file that is still being hashed */
+		status = db_save_checkpoint(job->origin,job->offset,&job->mdContext);
+
+	} else if(job->skipped == false)
+	{
+		if(SUCCESS == (status = job->status))
+		{
+			status = db_write_the_result(job);
+		}
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Write a single entry of the queue against the DB
+ *
+ */
+static Return write_the_entry
+(
+	const Write *write
+){
+	if(write->job != NULL)
+	{
+		return(write_the_result(write->job));
+	}
+
+	return(db_stamp_the_record(&write->ID));
+}
+
+/**
+ *
+ * Writer loop. Wait for a batch of writes, take everything that
+ * has been queued at once and write it holding the connection,
+ * until the queue is empty and closed. The traversal fills the
+ * queue up again meanwhile. While the traversal is busy with a
+ * huge file, a partial batch is written after the transaction
+ * interval and rows are committed by time
+ *
+ */
+static void *db_writer_thread(void *arg)
+{
+	(void)arg;
+
+	while(true)
+	{
+		pthread_mutex_lock(&writer.mutex);
+
+		struct timespec deadline;
+
+		clock_gettime(CLOCK_REALTIME,&deadline);
+		deadline.tv_sec += TRANSACTION_INTERVAL_MS / 1000;
+
+		bool timed_out = false;
+
+		while((writer.head == NULL || (writer.count < WRITER_BATCH && writer.flush == false))
+			&& writer.shutdown == false
+			&& timed_out == false)
+		{
+			if(ETIMEDOUT == pthread_cond_timedwait(&writer.write_added,&writer.mutex,&deadline))
+			{
+				timed_out = true;
+			}
+		}
+
+		Write *write = writer.head;
+
+		if(write == NULL && writer.shutdown == true)
+		{
+			// Closed and nothing left to write
+			pthread_mutex_unlock(&writer.mutex);
+			break;
+		}
+
+		writer.head = NULL;
+		writer.tail = NULL;
+		writer.count = 0;
+		writer.flush = false;
+
+		Return status = writer.status;
+
+		pthread_cond_broadcast(&writer.write_taken);
+		pthread_mutex_unlock(&writer.mutex);
+
+		db_writer_lock();
+
+		while(write != NULL)
+		{
+			if(SUCCESS == status)
+			{
+				status = write_the_entry(write);
+			}
+
+			Write *next = write->next;
+
+			free_hash_job(write->job);
+			free(write);
+
+			write = next;
+		}
+
+		if(SUCCESS == status)
+		{
+			// Nothing could be handed over for long
+			status = db_transaction_commit_due();
+		}
+
+		db_writer_unlock();
+
+		if(SUCCESS != status)
+		{
+			pthread_mutex_lock(&writer.mutex);
+			if(SUCCESS == writer.status)
+			{
+				writer.status = status;
+			}
+			pthread_mutex_unlock(&writer.mutex);
+		}
+	}
+
+	return(NULL);
+}
+
+/**
+ *
+ * Start the writer. Everything written against the
+ * DB during the traversal goes through it
+ *
+ */
+Return db_writer_init(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	memset(&writer,0,sizeof(Writer));
+
+	if(sysconf(_SC_NPROCESSORS_ONLN) < 2)
+	{
+		// Everything is written by the traversal thread itself
+		return(status);
+	}
+
+	pthread_mutex_init(&writer.mutex,NULL);
+	pthread_cond_init(&writer.write_added,NULL);
+	pthread_cond_init(&writer.write_taken,NULL);
+
+	if(0 != pthread_create(&writer.thread,NULL,db_writer_thread,NULL))
+	{
+		slog(false,"Can't start the database writer\n");
+		pthread_cond_destroy(&writer.write_taken);
+		pthread_cond_destroy(&writer.write_added);
+		pthread_mutex_destroy(&writer.mutex);
+		status = FAILURE;
+		return(status);
+	}
+
+	writer.started = true;
+
+	slog(true,"Started the database writer\n");
+
+	// Lookups don't wait for the writer if
+	// SQLite could be used by both threads
+	if(SUCCESS != (status = db_reader_open()))
+	{
+		db_writer_free();
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Put a write into the queue. Wait while the queue is full.
+ * Returns the failure of the writer if any, so the traversal
+ * stops as soon as something could not be written. Without
+ * the writer thread the write is done right away
+ *
+ */
+static Return db_writer_push
+(
+	HashJob *job,
+	sqlite3_int64 ID
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	if(writer.started == false)
+	{
+		// Written right away by the caller
+		const Write entry = {job,ID,NULL};
+
+		status = write_the_entry(&entry);
+
+		free_hash_job(job);
+
+		return(status);
+	}
+
+	Write *write = (Write *)calloc(1,sizeof(Write));
+	if(write == NULL)
+	{
+		slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+		free_hash_job(job);
+		status = FAILURE;
+		return(status);
+	}
+
+	write->job = job;
+	write->ID = ID;
+
+	if(job != NULL && job->fd >= 0)
+	{
+		// The writer doesn't need the file, so
+		// it doesn't stay open in the queue
+		close(job->fd);
+		job->fd = -1;
+	}
+
+
+	pthread_mutex_lock(&writer.mutex);
+
+	while(writer.count >= WRITER_QUEUE_CAPACITY && SUCCESS == writer.status)
+	{
+		pthread_cond_wait(&writer.write_taken,&writer.mutex);
+	}
+
+	if(SUCCESS != (status = writer.status))
+	{
+		pthread_mutex_unlock(&writer.mutex);
+		free_hash_job(job);
+		free(write);
+		return(status);
+	}
+
+	if(writer.tail == NULL)
+	{
+		writer.head = write;
+	} else {
+		writer.tail->next = write;
+	}
+	writer.tail = write;
+	writer.count++;
+
+	if(job != NULL && job->origin != NULL)
+	{
+		// The state of a file being hashed is saved at once
+		writer.flush = true;
+	}
+
+	if(writer.count == WRITER_BATCH || writer.flush == true)
+	{
+		pthread_cond_signal(&writer.write_added);
+	}
+	pthread_mutex_unlock(&writer.mutex);
+
+	return(status);
+}
+
+/**
+ *
+ * Hand a finished job over to the writer.
+ * The writer releases the job
+ *
+ */
+Return db_writer_submit
+(
+	HashJob *job
+){
+	if(job == NULL)
+	{
+		return(SUCCESS);
+	}
+
+	return(db_writer_push(job,0));
+}
+
+/**
+ *
+ * Let the writer stamp the record of a file
+ * seen by the current scan
+ *
+ */
+Return db_writer_stamp
+(
+	const sqlite3_int64 *ID
+){
+	return(db_writer_push(NULL,*ID));
+}
+
+/**
+ *
+ * Take the connection for reading from the thread
+ * of the traversal while the writer is running
+ *
+ */
+void db_writer_lock(void)
+{
+	pthread_mutex_lock(&connection);
+}
+
+/**
+ *
+ * Give the connection back
+ *
+ */
+void db_writer_unlock(void)
+{
+	pthread_mutex_unlock(&connection);
+}
+
+/**
+ *
+ * Commit rows written by the traversal thread itself once
+ * the transaction is old enough. Called while the traversal
+ * is busy with a huge file or waits for workers. The writer
+ * thread commits its rows on its own
+ *
+ */
+Return db_writer_commit_due(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	if(writer.started == true)
+	{
+		return(status);
+	}
+
+	db_writer_lock();
+	status = db_transaction_commit_due();
+	db_writer_unlock();
+
+	return(status);
+}
+
+/**
+ *
+ * Wait until everything in the queue has been written
+ * and stop the writer. Returns the failure of the
+ * writer if any
+ *
+ */
+Return db_writer_free(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	if(writer.started == false)
+	{
+		return(status);
+	}
+
+	pthread_mutex_lock(&writer.mutex);
+	writer.shutdown = true;
+	pthread_cond_signal(&writer.write_added);
+	pthread_mutex_unlock(&writer.mutex);
+
+	pthread_join(writer.thread,NULL);
+
+	db_reader_close();
+
+	status = writer.status;
+
+	pthread_cond_destroy(&writer.write_taken);
+	pthread_cond_destroy(&writer.write_added);
+	pthread_mutex_destroy(&writer.mutex);
+
+	memset(&writer,0,sizeof(Writer));
+
+	return(status);
+}
@@ -1,5 +1,4 @@
 #include "precizer.h"
-#include <fts.h>
 
 /**
  *
@@ -7,10 +6,8 @@
  * a struct for each file it encounters
  *
 */
-Return file_list
-(
-	bool count_size_of_all_files
-){
+Return file_list(void)
+{
 	/// The status that will be passed to return() before exiting.
 	/// By default, the function worked without errors.
 	Return status = SUCCESS;
@@ -21,11 +18,6 @@ Return file_list
 		return(status);
 	}
 
-	if(config->progress == false && count_size_of_all_files == true){
-		// Don't do anything
-		return(status);
-	}
-
 	// Flags that reflect the presence of any changes
 	// since the last research
 	bool first_iteration = true;
@@ -34,45 +26,27 @@ Return file_list
 	bool include_showed_once = false;
 	bool at_least_one_file_was_shown = false;
 
-	FTS *file_systems = NULL;
-	FTSENT *p = NULL;
-	FTSENT *child = NULL;
+	TraversalEntry *p = NULL;
 
-	int fts_options = FTS_PHYSICAL | FTS_XDEV;
+	// Errors of the traversal by itself
+	Return traversal_status = SUCCESS;
 
-	size_t count_files = 0, count_dirs = 0, count_symlnks = 0;
+	bool hashing_in_parallel = config->threads > 0;
 
-	if ((file_systems = fts_open(config->paths, fts_options, NULL)) == NULL) {
-		slog(false,"fts_open() error\n");
-		status = FAILURE;
-		fts_close(file_systems);
-		return(status);
-	}
-
-	/* Initialize file_systems with as many argv[] parts as possible. */
-	child = fts_children(file_systems, 0);
-	if (child == NULL) {
-		 /* no files to traverse */
-		fts_close(file_systems);
-		return(status);
-	}
+	size_t count_files = 0, count_dirs = 0, count_symlnks = 0;
 
 	/*
-	 * Determine absolute path prefix
-	 * We are only interested in relative paths in DB
-	 * To get a relative path we need to trim the prefix from the absolute path
-	 */
-	char *runtime_path_prefix = NULL;
-	FTSENT *current_file_system = child;
-
-#if 0 // Old multiPATH solution
-	/**
-	 * Index of the path prefix
-	 * All full runtime paths are stored in the table "paths".
-	 * A real path can be retrieved due to its index ID
+	 * The traversal determines the absolute path prefix of every
+	 * path passed as an argument. We are only interested in
+	 * relative paths in DB. Files are opened by their short names
+	 * from directories found by the traversal and workers get
+	 * descriptors of already opened files
 	 */
-	sqlite3_int64 path_prefix_index = -1;
-#endif
+	if(SUCCESS != (status = traversal_init()))
+	{
+		traversal_free();
+		return(status);
+	}
 
 	// Limit recursion to the depth determined in config->maxdepth
 	if(config->maxdepth > -1)
@@ -80,7 +54,40 @@ Return file_list
 		slog(false,"Recursion depth limited to: %d\n", config->maxdepth);
 	}
 
-	while((p = fts_read(file_systems)) != NULL)
+	if(hashing_in_parallel == true)
+	{
+		if(SUCCESS != (status = hashing_pool_init()))
+		{
+			hashing_pool_free();
+			traversal_free();
+			return(status);
+		}
+	}
+
+	// Written rows are committed in batches
+	if(SUCCESS != (status = db_transaction_begin()))
+	{
+		if(hashing_in_parallel == true)
+		{
+			hashing_pool_free();
+		}
+		traversal_free();
+		return(status);
+	}
+
+	// Results are written against the DB by a thread of its own
+	if(SUCCESS != (status = db_writer_init()))
+	{
+		db_transaction_end();
+		if(hashing_in_parallel == true)
+		{
+			hashing_pool_free();
+		}
+		traversal_free();
+		return(status);
+	}
+
+	while(SUCCESS == (traversal_status = traversal_next(&p)) && p != NULL)
 	{
 		/* Interrupt the loop smoothly */
 		/* Interrupt when Ctrl+C */
@@ -88,62 +95,48 @@ Return file_list
 			break;
 		}
 
-		if (count_size_of_all_files == false)
-		{
-			/* Get absolute path prefix from FTSENT structure and current runtime path */
-			if (p == current_file_system){
-				// All below run once per new path prefix
-				char *tmp = (char *)realloc(runtime_path_prefix,(current_file_system->fts_pathlen + 1) * sizeof(char));
-				if(NULL == tmp)
-				{
-					slog(false,"Realloc error\n");
-					status = FAILURE;
-					break;
-				} else {
-					runtime_path_prefix = tmp;
-				}
-
-				// Remember temporary string in long-lasting variable
-				strcpy(runtime_path_prefix,current_file_system->fts_path);
-
-				// Remove unnecessary trailing slash at the end of the directory path
-				remove_trailing_slash(runtime_path_prefix);
+		switch (p->type) {
+		case ENTRY_DIRECTORY:
+			count_dirs++;
 
-				// The next
-				current_file_system = current_file_system->fts_link;
+			// The traversal doesn't descend into directories
+			// where every file would be ignored anyway
+			if(p->ignored == true)
+			{
+				DBrow dbrow;
+				memset(&dbrow,0,sizeof(DBrow));
+				int metadata_of_scanned_and_saved_files = NOT_EQUAL;
+				bool rehashig_from_the_beginning = false;
+				bool ignored = true;
 
-#if 0 // Old multiPATH solution
-				// If several paths were passed as arguments,
-				// then the counting of the path prefix index
-				// will start from zero
-				if(SUCCESS != (status = db_get_path_prefix_index(config,runtime_path_prefix,&path_prefix_index)))
-				{
-					break;
-				}
-#endif
+				show_relative_path(p->relative_path,&metadata_of_scanned_and_saved_files,&dbrow,&config->hash_algorithm,&p->stat,&first_iteration,&show_changes,&rehashig_from_the_beginning,&ignored,&at_least_one_file_was_shown);
 			}
-		}
-
-		switch (p->fts_info) {
-		case FTS_D:
-			count_dirs++;
 			break;
-		case FTS_F:
+		case ENTRY_FILE:
 			{
 				// Limit recursion to the depth determined in config->maxdepth
-				if(config->maxdepth > -1 && p->fts_level > config->maxdepth + 1)
+				if(config->maxdepth > -1 && p->level > config->maxdepth + 1)
 				{
 					break;
 				}
 
-				if (count_size_of_all_files == true){
-					config->total_size_in_bytes += (size_t)p->fts_statp->st_size;
-					count_files++;
-				} else if(runtime_path_prefix != NULL)
 				{
-					const char *relative_path = p->fts_path + strlen(runtime_path_prefix) + 1 + correction(p->fts_path + strlen(runtime_path_prefix) + 1);
-					struct stat *stat = p->fts_statp;
+					const char *relative_path = p->relative_path;
+					const struct stat *stat = &p->stat;
+
+					// The file belongs to the path passed as an argument
+					// it has been found in
+					const sqlite3_int64 path_prefix_index = config->path_prefix_indexes[p->root];
+
+					// Files before this one are done. Totals
+					// are known only at the end of the walk
+					progress_update(count_files,config->total_size_in_bytes);
+
 					count_files++;
+					config->total_size_in_bytes += (size_t)stat->st_size;
+
+					config->path_files[p->root]++;
+					config->path_size_in_bytes[p->root] += (size_t)stat->st_size;
 
 					/* Write all columns from DB row to the structure DBrow */
 					DBrow _dbrow;
@@ -151,11 +144,8 @@ Return file_list
 					// Clean the structure to prevent reuse;
 					memset(dbrow,0,sizeof(DBrow));
 
-#if 0 // Old multiPATH solution
-					if(SUCCESS != (status = db_read_file_data_from(dbrow,&path_prefix_index,relative_path)))
-#endif
 					/* Get all file's metadata from the database */
-					if(SUCCESS != (status = db_read_file_data_from(dbrow,relative_path)))
+					if(SUCCESS != (status = db_read_file_data_from(dbrow,&path_prefix_index,relative_path)))
 					{
 						break;
 					}
@@ -164,44 +154,61 @@ Return file_list
 					// file has not changed since last scanning.
 					int metadata_of_scanned_and_saved_files = NOT_EQUAL;
 
+					// Files saved against the DB keep their own hash
+					// algorithm unless another one was set with --hash
+					HashAlgorithm algorithm = config->hash_algorithm;
+
+					if(dbrow->relative_path_already_in_db == true
+						&& config->hash_algorithm_specified == false
+						&& hash_digest_length(dbrow->saved_algorithm) > 0)
+					{
+						algorithm = dbrow->saved_algorithm;
+					}
+
+					// With --tree-hash the size of a file decides
+					// whether it is hashed as a tree of chunks
+					if(config->tree_hash_size > 0)
+					{
+						algorithm = hash_plain_of(algorithm);
+
+						if(stat->st_size >= config->tree_hash_size)
+						{
+							algorithm = hash_tree_of(algorithm);
+						}
+					}
+
 					if(dbrow->relative_path_already_in_db == true)
 					{
 						// Check up if size, creation and modification time of a
 						// file has not changed since last scanning.
-						metadata_of_scanned_and_saved_files = compare_file_metadata_equivalence(&(dbrow->saved_stat),p->fts_statp);
+						metadata_of_scanned_and_saved_files = compare_file_metadata_equivalence(&(dbrow->saved_stat),stat);
 
 						// The file metadata in DB and on the file system are identical
 						if(metadata_of_scanned_and_saved_files == IDENTICAL)
 						{
 							// The file saved against the database has been read
 							// from the file system in its entirety
-							if(dbrow->saved_offset == 0){
+							if(dbrow->saved_offset == 0 && dbrow->saved_algorithm == algorithm){
 								// Relative path already in DB and doesn't need any change
+								// except of the mark that it has been seen
+								status = db_writer_stamp(&dbrow->ID);
 								break;
 							}
 						}
 					}
 
-					sqlite3_int64 offset = 0; // Offset bytes
-					SHA512_Context mdContext;
-
 					// For a file which had been changed before creation of its checksum has been already finished.
 					bool rehashig_from_the_beginning = false;
 
 					// Ignored with --ignore= or admit with --include=
 					bool ignored = false;
 
-					if(dbrow->saved_offset > 0)
+					if(dbrow->saved_offset > 0 && (metadata_of_scanned_and_saved_files != IDENTICAL
+						|| dbrow->saved_algorithm != algorithm))
 					{
-						if (metadata_of_scanned_and_saved_files == IDENTICAL)
-						{
-							// Contunue hashing
-							offset = dbrow->saved_offset;
-							memcpy(&mdContext,&(dbrow->saved_mdContext),sizeof(SHA512_Context));
-						} else {
-							// The SHA512 hashing of the file had not been finished previously and the file has been changed
-							rehashig_from_the_beginning = true;
-						}
+						// The hashing of the file had not been finished previously and the file
+						// has been changed or should be hashed with another algorithm
+						rehashig_from_the_beginning = true;
 					}
 
 					/* PCRE2 regexp to include the file */
@@ -231,65 +238,137 @@ Return file_list
 						}
 					}
 
-					unsigned char sha512[SHA512_DIGEST_LENGTH];
-					memset(sha512,0,sizeof(sha512)); // Clean sha512 to prevent reuse;
-
 					// Print out of a file name and its changes
-					show_relative_path(relative_path,&metadata_of_scanned_and_saved_files,dbrow,p->fts_statp,&first_iteration,&show_changes,&rehashig_from_the_beginning,&ignored,&at_least_one_file_was_shown);
+					show_relative_path(relative_path,&metadata_of_scanned_and_saved_files,dbrow,&algorithm,stat,&first_iteration,&show_changes,&rehashig_from_the_beginning,&ignored,&at_least_one_file_was_shown);
 
 					if(ignored == true)
 					{
+						if(dbrow->relative_path_already_in_db == true)
+						{
+							// Removed with --db-clean-ignored if at all
+							status = db_writer_stamp(&dbrow->ID);
+						}
 						break;
 					}
 
-					if(SUCCESS != (status = sha512sum(p->fts_path,&p->fts_pathlen,sha512,&offset,&mdContext)))
+					/* The job for hashing */
+					HashJob *job = (HashJob *)calloc(1,sizeof(HashJob));
+					if(job == NULL)
 					{
+						slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+						status = FAILURE;
 						break;
 					}
 
-					bool update_db = false;
+					// Not opened yet
+					job->fd = -1;
 
-					if (dbrow->relative_path_already_in_db == true)
+					job->path_prefix_index = path_prefix_index;
+					job->relative_path = strdup(relative_path);
+					job->path = strdup(p->path);
+					if(job->relative_path == NULL || job->path == NULL)
 					{
-						if(offset > dbrow->saved_offset)
+						slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+						free_hash_job(job);
+						status = FAILURE;
+						break;
+					}
+					memcpy(&job->stat,stat,sizeof(struct stat));
+					memcpy(&job->dbrow,dbrow,sizeof(DBrow));
+					job->metadata_of_scanned_and_saved_files = metadata_of_scanned_and_saved_files;
+					job->algorithm = algorithm;
+
+					if(dbrow->saved_offset > 0 && rehashig_from_the_beginning == false)
+					{
+						// Contunue hashing
+						job->offset = dbrow->saved_offset;
+						memcpy(&job->mdContext,&(dbrow->saved_mdContext),sizeof(HashState));
+					}
+
+					/* Open the file from the directory it has been found in */
+					if(SUCCESS != (status = file_reader_prepare(job,p->dirfd,p->name)))
+					{
+						free_hash_job(job);
+						break;
+					}
+
+					if(hash_is_tree(job->algorithm) == true)
+					{
+						/* A huge file is hashed by all workers at once,
+						 * so let the pool get rid of other files first */
+						HashJob *done = NULL;
+
+						while(hashing_in_parallel == true && (done = hashing_pool_done(true)) != NULL)
 						{
-							// Update DB record
-							update_db = true;
+							if(SUCCESS != (status = db_writer_submit(done)))
+							{
+								break;
+							}
+						}
 
-						} else if(dbrow->saved_offset > 0 && offset == 0)
+						if(SUCCESS != status)
 						{
-							// Update DB record
-							update_db = true;
+							free_hash_job(job);
+							break;
+						}
 
-						} else if(metadata_of_scanned_and_saved_files != IDENTICAL)
+						job->status = tree_hash(job);
+
+						status = db_writer_submit(job);
+
+						if(SUCCESS != status)
 						{
-							// Update DB record
-							update_db = true;
+							break;
 						}
-					}
 
-					/* In any other case NO need to update DB record just insert the record */
-					if(update_db == true)
+					} else if(config->threads == 0)
 					{
-						/* Update record in DB */
-						if(SUCCESS == (status = db_update_the_record(&(dbrow->ID),&offset,sha512,stat,&mdContext)))
+						/* Hash the file right here */
+						job->status = hashsum(job);
+
+						status = db_writer_submit(job);
+
+						if(SUCCESS != status)
 						{
-							// Reflect changes in global
-							config->something_has_been_changed = true;
-						} else {
 							break;
 						}
 
 					} else {
-						/* Insert to DB */
-#if 0 // Old multiPATH solution
-						if(SUCCESS != (status = db_insert_the_record(&path_prefix_index,relative_path,&offset,sha512,stat,&mdContext)))
-#endif
-						if(SUCCESS == (status = db_insert_the_record(relative_path,&offset,sha512,stat,&mdContext)))
+
+						/* Collect finished jobs while there is no room for a new one */
+						while(hashing_pool_is_full() == true)
+						{
+							if(SUCCESS != (status = db_writer_submit(hashing_pool_done(true))))
+							{
+								break;
+							}
+						}
+
+						if(SUCCESS != status)
+						{
+							free_hash_job(job);
+							break;
+						}
+
+						if(SUCCESS != (status = hashing_pool_submit(job)))
+						{
+							free_hash_job(job);
+							break;
+						}
+
+						/* Save already finished jobs without waiting */
+						HashJob *done = NULL;
+
+						while((done = hashing_pool_done(false)) != NULL)
+						{
+							if(SUCCESS != (status = db_writer_submit(done)))
+							{
+								break;
+							}
+						}
+
+						if(SUCCESS != status)
 						{
-							// Reflect changes in global
-							config->something_has_been_changed = true;
-						} else {
 							break;
 						}
 					}
@@ -297,16 +376,14 @@ Return file_list
 					/**
 					 * Interrupt the loop smoothly
 					 * Interrupt when Ctrl+C
-					 * Don't write a result because sha512sum() function
-					 * has been interrupted and the sha512 contains wrong data
-					*/
+					 */
 					if(global_interrupt_flag == true){
 						break;
 					}
 				}
 			}
 			break;
-		case FTS_SL:
+		case ENTRY_SYMLINK:
 			count_symlnks++;
 			break;
 		default:
@@ -314,19 +391,58 @@ Return file_list
 		}
 	}
 
-	free(runtime_path_prefix);
+	if(SUCCESS != traversal_status)
+	{
+		status = traversal_status;
+	}
+
+	if(hashing_in_parallel == true)
+	{
+		/* Save all jobs that are still in flight. Interrupted
+		 * ones carry their offset and context to be resumed */
+		HashJob *done = NULL;
+
+		while(SUCCESS == status && (done = hashing_pool_done(true)) != NULL)
+		{
+			status = db_writer_submit(done);
+		}
+
+		hashing_pool_free();
+	}
+
+	// Wait for the writer to save everything handed over
+	Return writer_status = db_writer_free();
 
-	fts_close(file_systems);
+	if(SUCCESS == status)
+	{
+		status = writer_status;
+	}
+
+	// Commit the rest of rows, also on interruption
+	Return commit_status = db_transaction_end();
+
+	if(SUCCESS == status)
+	{
+		status = commit_status;
+	}
+
+	if(SUCCESS == status && global_interrupt_flag == false)
+	{
+		// Totals of the whole walk are the
+		// estimate for the next --progress
+		status = db_save_totals();
+	}
+
+	// Files could be hashed right here as well
+	file_reader_free();
+
+	traversal_free();
 
 	size_t total_items = count_dirs + count_files + count_symlnks;
 
 	if(config->progress == true)
 	{
-		if(count_size_of_all_files == true ||
-			(count_size_of_all_files == false && at_least_one_file_was_shown == true))
-		{
-			slog(false,"total size: %s, total items: %zu, dirs: %zu, files: %zu, symlnks: %zu\n",bkbmbgbtbpbeb(config->total_size_in_bytes),total_items,count_dirs,count_files,count_symlnks);
-		}
+		slog(false,"total size: %s, total items: %zu, dirs: %zu, files: %zu, symlnks: %zu\n",bkbmbgbtbpbeb(config->total_size_in_bytes),total_items,count_dirs,count_files,count_symlnks);
 	}
 
 	return(status);
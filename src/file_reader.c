@@ -0,0 +1,905 @@
+#include "precizer.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+
+/**
+ *
+ * @file file_reader.c
+ * @brief Reading of files for hashing
+ * @details On Linux reads are passed through io_uring, so several
+ * blocks of a file are requested at once and the device always has
+ * something to do while the previous block is being hashed. Every
+ * hashing thread (a worker or the traversal loop itself) has its own
+ * ring, so the depth of the device queue grows with --threads.
+ * If io_uring is not available (old kernel, seccomp, containers,
+ * non-Linux builds) the same queue of reads is served by a read-ahead
+ * thread, so the next block is being read while the current one is
+ * being hashed. Blocking reads are the last resort.
+ *
+ * The --cache-mode option keeps the page cache of the host intact:
+ * "direct" reads with O_DIRECT straight into the aligned buffers of
+ * the thread, "dontneed" drops pages behind the read cursor with
+ * posix_fadvise(POSIX_FADV_DONTNEED).
+ *
+ */
+
+#if defined(__linux__) && !defined(__COSMOPOLITAN__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifndef HAVE_IO_URING
+#define HAVE_IO_URING 0
+#endif
+
+#if HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+// Size of one read. The same as the buffer of the blocking reading had
+#define READ_BLOCK_SIZE (1024 * 1024)
+
+// Reads of a file requested at once
+#define READ_QUEUE_DEPTH 4
+
+// The result of a read that is not completed yet
+#define READ_PENDING INT_MIN
+
+// Offsets, sizes and buffers of O_DIRECT reads are aligned to it
+#define DIRECT_ALIGN 4096
+
+// With --cache-mode=dontneed pages are dropped in portions of this size
+#define DONTNEED_PORTION (8 * 1024 * 1024)
+
+// The way reads are performed
+typedef enum {
+
+	/// Nothing has been chosen yet
+	READ_NOT_READY = 0,
+
+	/// Reads are requested from io_uring
+	READ_IO_URING,
+
+	/// Reads are requested from the read-ahead thread
+	READ_THREAD,
+
+	/// One blocking read at a time
+	READ_BLOCKING
+
+} ReadBackend;
+
+typedef struct {
+
+	/// Buffers of all reads
+	unsigned char *buffers;
+
+	/// Number of buffers. 1 for blocking reads
+	unsigned int depth;
+
+	/// Results of requested reads in order of their offsets
+	int results[READ_QUEUE_DEPTH];
+
+	/// Bytes of the file wanted from every read. O_DIRECT
+	/// reads could request more to stay aligned
+	size_t wanted[READ_QUEUE_DEPTH];
+
+	/// The first slot of the queue and the number of
+	/// requested reads in the queue
+	unsigned int head;
+	unsigned int queued;
+
+	/// The first slot has been handed out already
+	bool handed_out;
+
+	/// Chosen on opening of the first file
+	ReadBackend backend;
+
+	/// The read-ahead thread and its queue. All fields
+	/// below are protected by the mutex
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t submitted_cond;
+	pthread_cond_t completed_cond;
+
+	/// Counters of reads passed to the thread and taken by it
+	unsigned int submitted;
+	unsigned int taken;
+
+	/// Slots in order they have been submitted
+	unsigned int order[READ_QUEUE_DEPTH];
+
+	/// What should be read into every slot
+	int fds[READ_QUEUE_DEPTH];
+	sqlite3_int64 offsets[READ_QUEUE_DEPTH];
+	size_t sizes[READ_QUEUE_DEPTH];
+
+	/// The thread should exit
+	bool shutdown;
+
+#if HAVE_IO_URING
+	/// Descriptor of the ring
+	int fd;
+
+	/// Submission queue
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	struct io_uring_sqe *sqes;
+
+	/// Completion queue
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	/// Mapped memory of the ring
+	void *sq_ptr;
+	size_t sq_size;
+	void *cq_ptr;
+	size_t cq_size;
+	size_t sqes_size;
+
+	/// Vectors of the reads
+	struct iovec iov[READ_QUEUE_DEPTH];
+
+	/// Reads submitted since the last io_uring_enter()
+	unsigned int to_submit;
+#endif
+
+} Reader;
+
+// Every hashing thread reads with its own buffers and ring
+static _Thread_local Reader reader;
+
+#if HAVE_IO_URING
+/**
+ *
+ * Set up the ring of the current thread. On any
+ * error the blocking reads will be used
+ *
+ */
+static bool ring_init(void)
+{
+	struct io_uring_params params;
+	memset(&params,0,sizeof(params));
+
+	reader.fd = (int)syscall(__NR_io_uring_setup,READ_QUEUE_DEPTH,&params);
+
+	if(reader.fd < 0)
+	{
+		slog(true,"io_uring is not available (%s)\n",strerror(errno));
+		return(false);
+	}
+
+	reader.sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	reader.cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if(reader.cq_size > reader.sq_size)
+		{
+			reader.sq_size = reader.cq_size;
+		}
+		reader.cq_size = reader.sq_size;
+	}
+
+	reader.sq_ptr = mmap(NULL,reader.sq_size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,reader.fd,IORING_OFF_SQ_RING);
+
+	if(reader.sq_ptr == MAP_FAILED)
+	{
+		reader.sq_ptr = NULL;
+	} else if(params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		reader.cq_ptr = reader.sq_ptr;
+	} else {
+		reader.cq_ptr = mmap(NULL,reader.cq_size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,reader.fd,IORING_OFF_CQ_RING);
+
+		if(reader.cq_ptr == MAP_FAILED)
+		{
+			reader.cq_ptr = NULL;
+		}
+	}
+
+	reader.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	void *sqes = mmap(NULL,reader.sqes_size,PROT_READ | PROT_WRITE,MAP_SHARED | MAP_POPULATE,reader.fd,IORING_OFF_SQES);
+
+	if(reader.sq_ptr == NULL || reader.cq_ptr == NULL || sqes == MAP_FAILED)
+	{
+		slog(true,"Can't map io_uring (%s)\n",strerror(errno));
+
+		if(sqes != MAP_FAILED)
+		{
+			munmap(sqes,reader.sqes_size);
+		}
+		if(reader.cq_ptr != NULL && reader.cq_ptr != reader.sq_ptr)
+		{
+			munmap(reader.cq_ptr,reader.cq_size);
+		}
+		if(reader.sq_ptr != NULL)
+		{
+			munmap(reader.sq_ptr,reader.sq_size);
+		}
+		close(reader.fd);
+		reader.sq_ptr = NULL;
+		reader.cq_ptr = NULL;
+		return(false);
+	}
+
+	unsigned char *sq = (unsigned char *)reader.sq_ptr;
+	unsigned char *cq = (unsigned char *)reader.cq_ptr;
+
+	reader.sq_head = (unsigned int *)(void *)(sq + params.sq_off.head);
+	reader.sq_tail = (unsigned int *)(void *)(sq + params.sq_off.tail);
+	reader.sq_mask = (unsigned int *)(void *)(sq + params.sq_off.ring_mask);
+	reader.sq_array = (unsigned int *)(void *)(sq + params.sq_off.array);
+	reader.sqes = (struct io_uring_sqe *)sqes;
+
+	reader.cq_head = (unsigned int *)(void *)(cq + params.cq_off.head);
+	reader.cq_tail = (unsigned int *)(void *)(cq + params.cq_off.tail);
+	reader.cq_mask = (unsigned int *)(void *)(cq + params.cq_off.ring_mask);
+	reader.cqes = (struct io_uring_cqe *)(void *)(cq + params.cq_off.cqes);
+
+	return(true);
+}
+
+/**
+ *
+ * Release the ring of the current thread
+ *
+ */
+static void ring_free(void)
+{
+	munmap(reader.sqes,reader.sqes_size);
+
+	if(reader.cq_ptr != reader.sq_ptr)
+	{
+		munmap(reader.cq_ptr,reader.cq_size);
+	}
+	munmap(reader.sq_ptr,reader.sq_size);
+
+	close(reader.fd);
+}
+
+/**
+ *
+ * Put a read of the slot into the submission queue
+ *
+ */
+static void ring_prepare_read
+(
+	const FileReader *file,
+	unsigned int slot,
+	size_t size
+){
+	unsigned int tail = *reader.sq_tail;
+	unsigned int index = tail & *reader.sq_mask;
+
+	struct io_uring_sqe *sqe = &reader.sqes[index];
+	memset(sqe,0,sizeof(struct io_uring_sqe));
+
+	reader.iov[slot].iov_base = reader.buffers + (size_t)slot * READ_BLOCK_SIZE;
+	reader.iov[slot].iov_len = size;
+
+	// READV is supported by all kernels having io_uring at all
+	sqe->opcode = IORING_OP_READV;
+	sqe->fd = file->fd;
+	sqe->addr = (uint64_t)(uintptr_t)&reader.iov[slot];
+	sqe->len = 1;
+	sqe->off = (uint64_t)file->requested;
+	sqe->user_data = slot;
+
+	reader.sq_array[index] = index;
+
+	__atomic_store_n(reader.sq_tail,tail + 1,__ATOMIC_RELEASE);
+
+	reader.to_submit++;
+}
+
+/**
+ *
+ * Submit prepared reads and, if wait is true, block
+ * until at least one read will be completed. The
+ * results are stored into their slots
+ *
+ */
+static Return ring_enter
+(
+	bool wait
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	while(reader.to_submit > 0 || wait == true)
+	{
+		long rc = syscall(__NR_io_uring_enter,reader.fd,reader.to_submit,wait ? 1 : 0,wait ? IORING_ENTER_GETEVENTS : 0,NULL,0);
+
+		if(rc < 0)
+		{
+			// Ctrl+C could come during the waiting
+			if(errno == EINTR || errno == EAGAIN)
+			{
+				continue;
+			}
+
+			slog(false,"io_uring_enter error: %s\n",strerror(errno));
+			status = FAILURE;
+			break;
+		}
+
+		reader.to_submit -= (unsigned int)rc;
+		break;
+	}
+
+	unsigned int head = *reader.cq_head;
+
+	while(head != __atomic_load_n(reader.cq_tail,__ATOMIC_ACQUIRE))
+	{
+		const struct io_uring_cqe *cqe = &reader.cqes[head & *reader.cq_mask];
+
+		reader.results[cqe->user_data] = cqe->res;
+		head++;
+	}
+
+	__atomic_store_n(reader.cq_head,head,__ATOMIC_RELEASE);
+
+	return(status);
+}
+#endif
+
+/**
+ *
+ * The read-ahead thread. Reads the slots in order they have
+ * been submitted while the owner hashes the previous ones
+ *
+ */
+static void *read_ahead
+(
+	void *arg
+){
+	Reader *r = (Reader *)arg;
+
+	pthread_mutex_lock(&r->mutex);
+
+	while(true)
+	{
+		while(r->taken == r->submitted && r->shutdown == false)
+		{
+			pthread_cond_wait(&r->submitted_cond,&r->mutex);
+		}
+
+		if(r->taken == r->submitted)
+		{
+			break;
+		}
+
+		unsigned int slot = r->order[r->taken % READ_QUEUE_DEPTH];
+		r->taken++;
+
+		int fd = r->fds[slot];
+		sqlite3_int64 offset = r->offsets[slot];
+		size_t size = r->sizes[slot];
+
+		pthread_mutex_unlock(&r->mutex);
+
+		ssize_t res = 0;
+
+		while((res = pread(fd,r->buffers + (size_t)slot * READ_BLOCK_SIZE,size,offset)) < 0 && errno == EINTR);
+
+		int result = res < 0 ? -errno : (int)res;
+
+		pthread_mutex_lock(&r->mutex);
+
+		r->results[slot] = result;
+
+		pthread_cond_signal(&r->completed_cond);
+	}
+
+	pthread_mutex_unlock(&r->mutex);
+
+	return(NULL);
+}
+
+/**
+ *
+ * Start the read-ahead thread of the current thread
+ *
+ */
+static bool thread_init(void)
+{
+	pthread_mutex_init(&reader.mutex,NULL);
+	pthread_cond_init(&reader.submitted_cond,NULL);
+	pthread_cond_init(&reader.completed_cond,NULL);
+
+	// The address of the thread local structure of the owner
+	if(0 != pthread_create(&reader.thread,NULL,read_ahead,&reader))
+	{
+		slog(true,"Can't start a read-ahead thread, files will be read with blocking reads\n");
+
+		pthread_cond_destroy(&reader.completed_cond);
+		pthread_cond_destroy(&reader.submitted_cond);
+		pthread_mutex_destroy(&reader.mutex);
+		return(false);
+	}
+
+	return(true);
+}
+
+/**
+ *
+ * Stop the read-ahead thread of the current thread
+ *
+ */
+static void thread_free(void)
+{
+	pthread_mutex_lock(&reader.mutex);
+	reader.shutdown = true;
+	pthread_cond_signal(&reader.submitted_cond);
+	pthread_mutex_unlock(&reader.mutex);
+
+	pthread_join(reader.thread,NULL);
+
+	pthread_cond_destroy(&reader.completed_cond);
+	pthread_cond_destroy(&reader.submitted_cond);
+	pthread_mutex_destroy(&reader.mutex);
+}
+
+/**
+ *
+ * Request a read of the slot starting from the
+ * "requested" offset of the file
+ *
+ */
+static void prepare_read
+(
+	const FileReader *file,
+	unsigned int slot,
+	size_t size
+){
+	reader.results[slot] = READ_PENDING;
+
+#if HAVE_IO_URING
+	if(reader.backend == READ_IO_URING)
+	{
+		ring_prepare_read(file,slot,size);
+		return;
+	}
+#endif
+
+	pthread_mutex_lock(&reader.mutex);
+
+	reader.fds[slot] = file->fd;
+	reader.offsets[slot] = file->requested;
+	reader.sizes[slot] = size;
+	reader.order[reader.submitted % READ_QUEUE_DEPTH] = slot;
+	reader.submitted++;
+
+	pthread_cond_signal(&reader.submitted_cond);
+	pthread_mutex_unlock(&reader.mutex);
+}
+
+/**
+ *
+ * Wait until the read of the slot will be completed
+ *
+ */
+static Return wait_for
+(
+	unsigned int slot
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+#if HAVE_IO_URING
+	if(reader.backend == READ_IO_URING)
+	{
+		if(SUCCESS != (status = ring_enter(false)))
+		{
+			return(status);
+		}
+
+		while(reader.results[slot] == READ_PENDING)
+		{
+			if(SUCCESS != (status = ring_enter(true)))
+			{
+				break;
+			}
+		}
+
+		return(status);
+	}
+#endif
+
+	pthread_mutex_lock(&reader.mutex);
+
+	while(reader.results[slot] == READ_PENDING)
+	{
+		pthread_cond_wait(&reader.completed_cond,&reader.mutex);
+	}
+
+	pthread_mutex_unlock(&reader.mutex);
+
+	return(status);
+}
+
+/**
+ *
+ * Open the file of a job by its name within the directory
+ * the traversal has found it in, so all the directories are
+ * already resolved and openat() has to look up just one
+ * name. Files are opened with O_NOATIME when
+ * allowed, so hashing leaves no trace on the source storage.
+ * Zero-length files are never opened
+ *
+ */
+Return file_reader_prepare
+(
+	HashJob *job,
+	int dirfd,
+	const char *name
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	job->fd = -1;
+
+	if(job->stat.st_size == 0)
+	{
+		return(status);
+	}
+
+	int flags = O_RDONLY | O_CLOEXEC;
+
+#ifdef O_NOATIME
+	// Only the owner of a file or root could do that
+	if(geteuid() == 0 || geteuid() == job->stat.st_uid)
+	{
+		flags |= O_NOATIME;
+	}
+#endif
+
+	// An offset saved by an interrupted run could be unaligned
+	job->direct = config->cache_mode == CACHE_DIRECT && job->offset % DIRECT_ALIGN == 0;
+
+	if(job->direct == true)
+	{
+		flags |= O_DIRECT;
+	}
+
+	while((job->fd = openat(dirfd,name,flags)) < 0)
+	{
+#ifdef O_NOATIME
+		if(errno == EPERM && (flags & O_NOATIME))
+		{
+			// Root without CAP_FOWNER in a container
+			flags &= ~O_NOATIME;
+			continue;
+		}
+#endif
+		if(errno == EINVAL && (flags & O_DIRECT))
+		{
+			// File systems like tmpfs don't support O_DIRECT
+			flags &= ~O_DIRECT;
+			job->direct = false;
+			continue;
+		}
+
+		if(errno != EINTR)
+		{
+			slog(false,"Can't open the file %s: %s\n",job->path,strerror(errno));
+			status = FAILURE;
+			break;
+		}
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Start reading of the file opened for a job from
+ * the offset of the job. If the length of the job is
+ * not 0, only that many bytes will be read
+ *
+ */
+Return file_reader_open
+(
+	FileReader *file,
+	const HashJob *job
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	memset(file,0,sizeof(FileReader));
+
+	if(reader.buffers == NULL)
+	{
+		reader.buffers = (unsigned char *)aligned_alloc(DIRECT_ALIGN,(size_t)READ_QUEUE_DEPTH * READ_BLOCK_SIZE);
+
+		if(reader.buffers == NULL)
+		{
+			slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+			status = FAILURE;
+			return(status);
+		}
+
+#if HAVE_IO_URING
+		if(ring_init() == true)
+		{
+			reader.backend = READ_IO_URING;
+		}
+#endif
+		if(reader.backend == READ_NOT_READY)
+		{
+			reader.backend = thread_init() ? READ_THREAD : READ_BLOCKING;
+		}
+
+		reader.depth = reader.backend == READ_BLOCKING ? 1 : READ_QUEUE_DEPTH;
+	}
+
+	reader.head = 0;
+	reader.queued = 0;
+	reader.handed_out = false;
+
+	file->fd = job->fd;
+	file->direct = job->direct;
+	file->path = job->path;
+	file->size = job->stat.st_size;
+	file->offset = job->offset;
+	file->requested = job->offset;
+	file->end = job->length > 0 ? job->offset + job->length : 0;
+	file->dropped = job->offset;
+
+	if(config->cache_mode == CACHE_DONTNEED)
+	{
+		posix_fadvise(file->fd,file->offset,0,POSIX_FADV_SEQUENTIAL);
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Size of the next read. O_DIRECT reads are rounded
+ * up to the alignment, what is fine at the end of file
+ *
+ */
+static size_t read_size
+(
+	const FileReader *file,
+	sqlite3_int64 from,
+	size_t *wanted
+){
+	*wanted = READ_BLOCK_SIZE;
+
+	if(file->end > 0 && file->end - from < (sqlite3_int64)*wanted)
+	{
+		*wanted = (size_t)(file->end - from);
+	}
+
+	if(file->direct == true)
+	{
+		return((*wanted + DIRECT_ALIGN - 1) & ~(size_t)(DIRECT_ALIGN - 1));
+	}
+
+	return(*wanted);
+}
+
+/**
+ *
+ * With --cache-mode=dontneed drop pages of the file that
+ * have been already hashed. If all is true, drop pages
+ * read ahead as well
+ *
+ */
+static void drop_pages
+(
+	FileReader *file,
+	bool all
+){
+	if(config->cache_mode != CACHE_DONTNEED)
+	{
+		return;
+	}
+
+	if(all == true)
+	{
+		sqlite3_int64 until = file->requested > file->offset ? file->requested : file->offset;
+
+		// The length 0 would mean the whole rest of the file
+		if(until > file->dropped)
+		{
+			posix_fadvise(file->fd,file->dropped,until - file->dropped,POSIX_FADV_DONTNEED);
+		}
+		file->dropped = until;
+
+	} else if(file->offset - file->dropped >= DONTNEED_PORTION)
+	{
+		posix_fadvise(file->fd,file->dropped,file->offset - file->dropped,POSIX_FADV_DONTNEED);
+		file->dropped = file->offset;
+	}
+}
+
+/**
+ *
+ * Get the next portion of the file. The buffer is valid
+ * until the next call. The length 0 means the end of file
+ *
+ */
+Return file_reader_next
+(
+	FileReader *file,
+	const unsigned char **buffer,
+	size_t *len
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	*len = 0;
+
+	if(file->eof == true)
+	{
+		return(status);
+	}
+
+	drop_pages(file,false);
+
+	/* The slot handed out previously is free again */
+	if(reader.handed_out == true)
+	{
+		reader.head = (reader.head + 1) % reader.depth;
+		reader.queued--;
+		reader.handed_out = false;
+	}
+
+	// Small files and the very end of a file don't need
+	// any queue, a single read is enough
+	if(reader.backend != READ_BLOCKING
+		&& (reader.queued > 0 || file->size - file->requested >= READ_BLOCK_SIZE))
+	{
+		/* Keep the queue full up to the size of the file. Behind
+		 * it only one read is requested to find out whether the
+		 * file has grown since it has been opened */
+		while(reader.queued < reader.depth
+			&& (file->end == 0 || file->requested < file->end)
+			&& (file->requested < file->size || reader.queued == 0))
+		{
+			unsigned int slot = (reader.head + reader.queued) % reader.depth;
+
+			size_t size = read_size(file,file->requested,&reader.wanted[slot]);
+
+			prepare_read(file,slot,size);
+			file->requested += (sqlite3_int64)reader.wanted[slot];
+			reader.queued++;
+		}
+
+		if(reader.queued == 0)
+		{
+			file->eof = true;
+			return(status);
+		}
+
+		if(SUCCESS != (status = wait_for(reader.head)))
+		{
+			return(status);
+		}
+
+		int res = reader.results[reader.head];
+
+		if(res < 0)
+		{
+			slog(false,"Can't read the file %s: %s\n",file->path,strerror(-res));
+			status = FAILURE;
+			return(status);
+		}
+
+		*len = (size_t)res;
+
+		if(*len < reader.wanted[reader.head])
+		{
+			// The end of file. Reads requested behind
+			// it are just waited out on closing
+			file->eof = true;
+
+		} else {
+			// The rest of an aligned O_DIRECT read
+			*len = reader.wanted[reader.head];
+		}
+
+		*buffer = reader.buffers + (size_t)reader.head * READ_BLOCK_SIZE;
+		file->offset += (sqlite3_int64)*len;
+		reader.handed_out = true;
+
+		return(status);
+	}
+
+	size_t wanted = 0;
+	size_t size = read_size(file,file->offset,&wanted);
+
+	ssize_t res = 0;
+
+	while(wanted > 0 && (res = pread(file->fd,reader.buffers,size,file->offset)) < 0 && errno == EINTR);
+
+	if(res < 0)
+	{
+		slog(false,"Can't read the file %s: %s\n",file->path,strerror(errno));
+		status = FAILURE;
+		return(status);
+	}
+
+	*len = (size_t)res;
+
+	if(*len == 0 || *len < wanted)
+	{
+		// A short read of a regular file means the end of it
+		file->eof = true;
+
+	} else if(*len > wanted)
+	{
+		// The rest of an aligned O_DIRECT read
+		*len = wanted;
+	}
+
+	*buffer = reader.buffers;
+	file->offset += (sqlite3_int64)*len;
+
+	return(status);
+}
+
+/**
+ *
+ * Stop reading of the file. Reads still in flight
+ * are waited out, since they write into the buffers
+ *
+ */
+void file_reader_close
+(
+	FileReader *file
+){
+	for(; reader.queued > 0; reader.queued--)
+	{
+		(void)wait_for(reader.head);
+		reader.head = (reader.head + 1) % reader.depth;
+	}
+
+	// The file itself is closed with its job
+	drop_pages(file,true);
+}
+
+/**
+ *
+ * Release buffers, the ring or the read-ahead thread of the current thread.
+ * Every thread that hashed files should call it
+ * before exiting
+ *
+ */
+void file_reader_free(void)
+{
+#if HAVE_IO_URING
+	if(reader.backend == READ_IO_URING)
+	{
+		ring_free();
+	}
+#endif
+
+	if(reader.backend == READ_THREAD)
+	{
+		thread_free();
+	}
+
+	free(reader.buffers);
+
+	memset(&reader,0,sizeof(Reader));
+}
@@ -16,9 +16,20 @@ void free_config(void)
 	term.c_lflag |= (ICANON|ECHO);
 	tcsetattr(fileno(stdin), 0, &term);
 
+	/* Statements keep the DB busy */
+	db_finalize_statements();
+
 	/* Close previously used DB */
 	sqlite3_close(config->db);
 
+	db_preload_free(config->preloaded);
+
+	free(config->path_prefix_indexes);
+
+	free(config->path_files);
+
+	free(config->path_size_in_bytes);
+
 	free(config->running_dir);
 
 	free(config->db_file_path);
@@ -34,6 +45,10 @@ void free_config(void)
 		free(config->db_file_names);
 	}
 
+	// Compiled regular expressions refer to the arrays below
+	regexp_free(config->ignore_regexp);
+	regexp_free(config->include_regexp);
+
 	// Free memory of string array
 	if(config->ignore != NULL)
 	{
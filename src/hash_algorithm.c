@@ -0,0 +1,280 @@
+#include "precizer.h"
+
+/**
+ *
+ * @file hash_algorithm.c
+ * @brief The same interface for all supported hash algorithms
+ * @details Every file saved against the DB remembers the algorithm
+ * its checksum has been calculated with, so the rest of the program
+ * doesn't depend on any particular one. SHA512 is the default.
+ * BLAKE3 is several times faster and is good enough for replication
+ * checks where cryptographic strength is not the point.
+ * Either of them could be applied to a tree of chunks
+ * (see tree_hash.c), what is a distinct algorithm as its
+ * checksums differ from the checksums of whole files.
+ *
+ */
+
+/**
+ *
+ * Start hashing from the beginning of a file
+ *
+ */
+Return hash_init
+(
+	HashAlgorithm algorithm,
+	HashContext *mdContext
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	int rc = 1;
+
+	switch(algorithm)
+	{
+		case HASH_SHA512:
+			rc = sha512_init(&mdContext->sha512);
+			break;
+		case HASH_BLAKE3:
+			rc = blake3_init(&mdContext->blake3);
+			break;
+		default:
+			break;
+	}
+
+	if(rc != 0)
+	{
+		slog(false,"Can't initialize %s hashing\n",hash_algorithm_name(algorithm));
+		status = FAILURE;
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Pass the next portion of a file through the hash
+ *
+ */
+Return hash_update
+(
+	HashAlgorithm algorithm,
+	HashContext *mdContext,
+	const unsigned char *buffer,
+	size_t len
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	int rc = 1;
+
+	switch(algorithm)
+	{
+		case HASH_SHA512:
+			rc = sha512_update(&mdContext->sha512,buffer,len);
+			break;
+		case HASH_BLAKE3:
+			rc = blake3_update(&mdContext->blake3,buffer,len);
+			break;
+		default:
+			break;
+	}
+
+	if(rc != 0)
+	{
+		slog(false,"%s hashing error\n",hash_algorithm_name(algorithm));
+		status = FAILURE;
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Get the checksum. The buffer should be at least
+ * MAX_DIGEST_LENGTH bytes long
+ *
+ */
+Return hash_final
+(
+	HashAlgorithm algorithm,
+	HashContext *mdContext,
+	unsigned char *checksum
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	int rc = 1;
+
+	switch(algorithm)
+	{
+		case HASH_SHA512:
+			rc = sha512_final(&mdContext->sha512,checksum);
+			break;
+		case HASH_BLAKE3:
+			rc = blake3_final(&mdContext->blake3,checksum);
+			break;
+		default:
+			break;
+	}
+
+	if(rc != 0)
+	{
+		slog(false,"Can't finalize %s hashing\n",hash_algorithm_name(algorithm));
+		status = FAILURE;
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Length of the checksum in bytes
+ *
+ */
+size_t hash_digest_length
+(
+	HashAlgorithm algorithm
+){
+	switch(algorithm)
+	{
+		case HASH_SHA512:
+		case HASH_SHA512_TREE:
+			return(SHA512_DIGEST_LENGTH);
+		case HASH_BLAKE3:
+		case HASH_BLAKE3_TREE:
+			return(BLAKE3_OUT_LEN);
+		default:
+			return(0);
+	}
+}
+
+/**
+ *
+ * Size of the hashing state that is
+ * saved against the DB
+ *
+ */
+size_t hash_context_size
+(
+	HashAlgorithm algorithm
+){
+	switch(algorithm)
+	{
+		case HASH_SHA512:
+			return(sizeof(SHA512_Context));
+		case HASH_BLAKE3:
+			return(sizeof(blake3_hasher));
+		case HASH_SHA512_TREE:
+		case HASH_BLAKE3_TREE:
+			return(sizeof(TreeContext));
+		default:
+			return(0);
+	}
+}
+
+/**
+ *
+ * Human readable name of the algorithm
+ *
+ */
+const char *hash_algorithm_name
+(
+	HashAlgorithm algorithm
+){
+	switch(algorithm)
+	{
+		case HASH_SHA512:
+			return("SHA512");
+		case HASH_BLAKE3:
+			return("BLAKE3");
+		case HASH_SHA512_TREE:
+			return("SHA512-TREE");
+		case HASH_BLAKE3_TREE:
+			return("BLAKE3-TREE");
+		default:
+			return("unknown");
+	}
+}
+
+/**
+ *
+ * True if checksums of the algorithm are
+ * calculated over a tree of chunks
+ *
+ */
+bool hash_is_tree
+(
+	HashAlgorithm algorithm
+){
+	return(algorithm == HASH_SHA512_TREE || algorithm == HASH_BLAKE3_TREE);
+}
+
+/**
+ *
+ * The tree variant of an algorithm
+ *
+ */
+HashAlgorithm hash_tree_of
+(
+	HashAlgorithm algorithm
+){
+	switch(algorithm)
+	{
+		case HASH_SHA512:
+			return(HASH_SHA512_TREE);
+		case HASH_BLAKE3:
+			return(HASH_BLAKE3_TREE);
+		default:
+			return(algorithm);
+	}
+}
+
+/**
+ *
+ * The algorithm that hashes chunks and
+ * the root of a tree variant
+ *
+ */
+HashAlgorithm hash_plain_of
+(
+	HashAlgorithm algorithm
+){
+	switch(algorithm)
+	{
+		case HASH_SHA512_TREE:
+			return(HASH_SHA512);
+		case HASH_BLAKE3_TREE:
+			return(HASH_BLAKE3);
+		default:
+			return(algorithm);
+	}
+}
+
+/**
+ *
+ * Find the algorithm by its name passed with --hash.
+ * The case of letters doesn't matter
+ *
+ */
+bool hash_algorithm_by_name
+(
+	const char *name,
+	HashAlgorithm *algorithm
+){
+	const HashAlgorithm all[] = {HASH_SHA512,HASH_BLAKE3};
+
+	for(size_t i = 0; i < sizeof(all)/sizeof(all[0]); i++)
+	{
+		if(strcasecmp(name,hash_algorithm_name(all[i])) == 0)
+		{
+			*algorithm = all[i];
+			return(true);
+		}
+	}
+
+	return(false);
+}
@@ -0,0 +1,459 @@
+#include "precizer.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <errno.h>
+
+/**
+ *
+ * @file hashing_pool.c
+ * @brief A pool of workers that hash files in parallel
+ * @details The traversal loop only produces jobs (path, stat and
+ * saved DB row) and submits them into the pool. Workers consume
+ * the jobs, calculate checksums and put the finished jobs back.
+ * Finished jobs are collected by the traversal loop in order and
+ * handed over to the database writer, so all writes against the
+ * DB still happen in one place.
+ *
+ */
+
+// Stack size of a worker
+#define WORKER_STACK_SIZE (4 * 1024 * 1024)
+
+// Jobs that could be kept in flight for each worker
+#define JOBS_PER_WORKER 4
+
+typedef struct {
+
+	/// Protects all fields below
+	pthread_mutex_t mutex;
+
+	/// Signals that a new job has been submitted
+	pthread_cond_t job_submitted;
+
+	/// Signals that a job has been finished
+	pthread_cond_t job_finished;
+
+	/// Queue of jobs waiting to be hashed
+	HashJob *todo_head;
+	HashJob *todo_tail;
+
+	/// Queue of hashed jobs waiting to be written into DB
+	HashJob *done_head;
+	HashJob *done_tail;
+
+	/// Jobs submitted but not yet collected
+	size_t in_flight;
+
+	/// Upper limit of jobs in flight. Bounds memory usage
+	size_t capacity;
+
+	/// No more jobs will be submitted
+	bool shutdown;
+
+	/// Worker threads
+	pthread_t *workers;
+
+	/// Number of started workers
+	unsigned short count;
+
+} HashingPool;
+
+static HashingPool pool;
+
+/**
+ *
+ * Worker loop. Take a job, hash the file and
+ * pass the job back for writing into DB
+ *
+ */
+static void *hashing_worker(void *arg)
+{
+	(void)arg;
+
+	while(true)
+	{
+		pthread_mutex_lock(&pool.mutex);
+
+		while(pool.todo_head == NULL && pool.shutdown == false)
+		{
+			pthread_cond_wait(&pool.job_submitted,&pool.mutex);
+		}
+
+		HashJob *job = pool.todo_head;
+
+		if(job == NULL)
+		{
+			// Shutdown and nothing left to do
+			pthread_mutex_unlock(&pool.mutex);
+			break;
+		}
+
+		pool.todo_head = job->next;
+		if(pool.todo_head == NULL)
+		{
+			pool.todo_tail = NULL;
+		}
+		job->next = NULL;
+
+		pthread_mutex_unlock(&pool.mutex);
+
+		/* Interrupt smoothly. Don't start new files after Ctrl+C */
+		if(global_interrupt_flag == true)
+		{
+			job->skipped = true;
+		} else if(job->length > 0) {
+			job->status = tree_hash_chunk(job);
+		} else {
+			job->status = hashsum(job);
+		}
+
+		pthread_mutex_lock(&pool.mutex);
+
+		if(pool.done_tail == NULL)
+		{
+			pool.done_head = job;
+		} else {
+			pool.done_tail->next = job;
+		}
+		pool.done_tail = job;
+
+		pthread_cond_signal(&pool.job_finished);
+		pthread_mutex_unlock(&pool.mutex);
+	}
+
+	file_reader_free();
+
+	return(NULL);
+}
+
+/**
+ *
+ * Start hashing workers. The number of workers
+ * is determined by the --threads option
+ *
+ */
+Return hashing_pool_init(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	memset(&pool,0,sizeof(HashingPool));
+
+	pool.capacity = (size_t)config->threads * JOBS_PER_WORKER;
+
+	// Every job in flight keeps its file open. Raise the soft
+	// limit of descriptors if there could be too many of them
+	struct rlimit limit;
+
+	if(getrlimit(RLIMIT_NOFILE,&limit) == 0 && limit.rlim_cur != RLIM_INFINITY
+		&& limit.rlim_cur < pool.capacity * 2 + 64)
+	{
+		limit.rlim_cur = limit.rlim_max;
+
+		if(limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur > pool.capacity * 2 + 64)
+		{
+			limit.rlim_cur = pool.capacity * 2 + 64;
+		}
+
+		if(setrlimit(RLIMIT_NOFILE,&limit) != 0)
+		{
+			slog(true,"Can't raise the limit of open files: %s\n",strerror(errno));
+		}
+	}
+
+	pool.workers = (pthread_t *)calloc(config->threads,sizeof(pthread_t));
+	if(pool.workers == NULL)
+	{
+		slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+		status = FAILURE;
+		return(status);
+	}
+
+	pthread_mutex_init(&pool.mutex,NULL);
+	pthread_cond_init(&pool.job_submitted,NULL);
+	pthread_cond_init(&pool.job_finished,NULL);
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr,WORKER_STACK_SIZE);
+
+	for(unsigned short i = 0; i < config->threads; i++)
+	{
+		if(0 != pthread_create(&pool.workers[i],&attr,hashing_worker,NULL))
+		{
+			slog(false,"Can't start hashing worker %u\n",i);
+			status = FAILURE;
+			break;
+		}
+		pool.count++;
+	}
+
+	pthread_attr_destroy(&attr);
+
+	if(SUCCESS == status)
+	{
+		slog(true,"Started %u hashing workers\n",pool.count);
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Pass a job to workers. The caller should make sure
+ * with hashing_pool_is_full() that there is a room
+ * for the job
+ *
+ */
+Return hashing_pool_submit
+(
+	HashJob *job
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	job->next = NULL;
+
+	pthread_mutex_lock(&pool.mutex);
+
+	if(pool.todo_tail == NULL)
+	{
+		pool.todo_head = job;
+	} else {
+		pool.todo_tail->next = job;
+	}
+	pool.todo_tail = job;
+	pool.in_flight++;
+
+	pthread_cond_signal(&pool.job_submitted);
+	pthread_mutex_unlock(&pool.mutex);
+
+	return(status);
+}
+
+/**
+ *
+ * Take a finished job from the pool. If wait is true,
+ * block until any job in flight will be finished.
+ * Returns NULL when nothing is ready (or nothing is in
+ * flight at all)
+ *
+ */
+HashJob *hashing_pool_done
+(
+	bool wait
+){
+	HashJob *job = NULL;
+
+	pthread_mutex_lock(&pool.mutex);
+
+	if(wait == true)
+	{
+		while(pool.done_head == NULL && pool.in_flight > 0)
+		{
+			struct timespec deadline;
+
+			clock_gettime(CLOCK_REALTIME,&deadline);
+			deadline.tv_sec += TRANSACTION_INTERVAL_MS / 1000;
+
+			if(ETIMEDOUT == pthread_cond_timedwait(&pool.job_finished,&pool.mutex,&deadline))
+			{
+				/* Workers are busy with huge files, so rows written
+				 * so far are committed without waiting for them. A
+				 * failure shows up again at the last commit */
+				pthread_mutex_unlock(&pool.mutex);
+				db_writer_commit_due();
+				pthread_mutex_lock(&pool.mutex);
+			}
+		}
+	}
+
+	job = pool.done_head;
+
+	if(job != NULL)
+	{
+		pool.done_head = job->next;
+		if(pool.done_head == NULL)
+		{
+			pool.done_tail = NULL;
+		}
+		job->next = NULL;
+
+		if(job->origin == NULL)
+		{
+			pool.in_flight--;
+		} else {
+			// The next checkpoint of the job goes into a new entry
+			job->origin->checkpoint = NULL;
+		}
+	}
+
+	pthread_mutex_unlock(&pool.mutex);
+
+	return(job);
+}
+
+/**
+ *
+ * Pass the state of a job being hashed to the database writer.
+ * A checkpoint goes through the queue of finished jobs, so it is
+ * always written before the final result of the same job. If the previous checkpoint of the job is still
+ * waiting in the queue, it is just replaced with the new state.
+ * Without workers the state is saved against the DB right away
+ *
+ */
+Return hashing_pool_checkpoint
+(
+	HashJob *job
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	if(pool.workers == NULL)
+	{
+		db_writer_lock();
+		status = db_save_checkpoint(job,job->offset,&job->mdContext);
+		db_writer_unlock();
+
+		return(status);
+	}
+
+	pthread_mutex_lock(&pool.mutex);
+	HashJob *checkpoint = job->checkpoint;
+
+	if(checkpoint != NULL)
+	{
+		checkpoint->offset = job->offset;
+		memcpy(&checkpoint->mdContext,&job->mdContext,sizeof(HashState));
+	}
+	pthread_mutex_unlock(&pool.mutex);
+
+	if(checkpoint != NULL)
+	{
+		return(status);
+	}
+
+	checkpoint = (HashJob *)calloc(1,sizeof(HashJob));
+	if(checkpoint == NULL)
+	{
+		slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+		status = FAILURE;
+		return(status);
+	}
+
+	checkpoint->fd = -1;
+	checkpoint->origin = job;
+	checkpoint->offset = job->offset;
+	memcpy(&checkpoint->mdContext,&job->mdContext,sizeof(HashState));
+
+	pthread_mutex_lock(&pool.mutex);
+
+	if(pool.done_tail == NULL)
+	{
+		pool.done_head = checkpoint;
+	} else {
+		pool.done_tail->next = checkpoint;
+	}
+	pool.done_tail = checkpoint;
+	job->checkpoint = checkpoint;
+
+	pthread_cond_signal(&pool.job_finished);
+	pthread_mutex_unlock(&pool.mutex);
+
+	return(status);
+}
+
+/**
+ *
+ * True if no more jobs should be submitted until
+ * some finished ones will be collected
+ *
+ */
+bool hashing_pool_is_full(void)
+{
+	pthread_mutex_lock(&pool.mutex);
+	bool full = pool.in_flight >= pool.capacity;
+	pthread_mutex_unlock(&pool.mutex);
+
+	return(full);
+}
+
+/**
+ *
+ * Stop and join all workers. Jobs that had not
+ * been started or collected are released
+ *
+ */
+void hashing_pool_free(void)
+{
+	if(pool.workers == NULL)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&pool.mutex);
+
+	// Jobs that have never been started are dropped
+	HashJob *todo = pool.todo_head;
+	pool.todo_head = NULL;
+	pool.todo_tail = NULL;
+
+	pool.shutdown = true;
+	pthread_cond_broadcast(&pool.job_submitted);
+	pthread_mutex_unlock(&pool.mutex);
+
+	while(todo != NULL)
+	{
+		HashJob *next = todo->next;
+		free_hash_job(todo);
+		todo = next;
+	}
+
+	for(unsigned short i = 0; i < pool.count; i++)
+	{
+		pthread_join(pool.workers[i],NULL);
+	}
+
+	HashJob *job = NULL;
+
+	while((job = hashing_pool_done(false)) != NULL)
+	{
+		free_hash_job(job);
+	}
+
+	free(pool.workers);
+
+	pthread_cond_destroy(&pool.job_finished);
+	pthread_cond_destroy(&pool.job_submitted);
+	pthread_mutex_destroy(&pool.mutex);
+
+	memset(&pool,0,sizeof(HashingPool));
+}
+
+/**
+ *
+ * Release memory of a job
+ *
+ */
+void free_hash_job
+(
+	HashJob *job
+){
+	if(job == NULL)
+	{
+		return;
+	}
+
+	if(job->fd >= 0)
+	{
+		close(job->fd);
+	}
+
+	free(job->relative_path);
+	free(job->path);
+	free(job);
+}
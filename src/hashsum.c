@@ -0,0 +1,98 @@
+#include "precizer.h"
+
+/**
+ *
+ * Calculate the checksum of the file of a job with the hash
+ * algorithm of the job. Hashing starts from the offset of the
+ * job, and if the length of the job is not 0, only that many
+ * bytes are hashed
+ *
+ */
+Return hashsum
+(
+	HashJob *job
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	HashContext *mdContext = &job->mdContext.plain;
+
+	bool loop_was_interrupted = false;
+
+	if(job->offset == 0){
+		if(SUCCESS != (status = hash_init(job->algorithm,mdContext)))
+		{
+			return(status);
+		}
+	}
+
+	// Zero-length files are never opened
+	if(job->fd >= 0)
+	{
+		FileReader file;
+		const unsigned char *buffer = NULL;
+		size_t len = 0;
+
+		// Chunks of a tree are saved by tree_hash() as a whole
+		bool checkpoints = job->length == 0
+			&& (config->checkpoint_bytes > 0 || config->checkpoint_seconds > 0);
+		Checkpoint checkpoint;
+
+		if(SUCCESS != (status = file_reader_open(&file,job)))
+		{
+			return(status);
+		}
+
+		if(checkpoints == true)
+		{
+			checkpoint_start(&checkpoint,job->offset);
+		}
+
+		while (SUCCESS == (status = file_reader_next(&file,&buffer,&len)) && len != 0) // read from infile
+		{
+			/* Interrupt the loop smoothly */
+			/* Interrupt when Ctrl+C */
+			if(global_interrupt_flag == true){
+				loop_was_interrupted = true;
+				break;
+			}
+			if(SUCCESS != (status = hash_update(job->algorithm,mdContext,buffer,len)))
+			{
+				break;
+			}
+			job->offset += (sqlite3_int64)len;
+
+			if(checkpoints == true && checkpoint_is_due(&checkpoint,job->offset) == true)
+			{
+				if(SUCCESS != (status = hashing_pool_checkpoint(job)))
+				{
+					break;
+				}
+			}
+
+			// Without workers the file is hashed by the traversal
+			// itself and nothing else is written meanwhile
+			if(config->threads == 0 && SUCCESS != (status = db_writer_commit_due()))
+			{
+				break;
+			}
+		}
+
+		file_reader_close(&file);
+	}
+
+	if(SUCCESS == status && loop_was_interrupted == false){
+		job->offset = 0;
+		status = hash_final(job->algorithm,mdContext,job->checksum);
+	}
+
+#if 0
+	for(size_t i = 0; i < hash_digest_length(job->algorithm); i++) {
+		printf("%02x", job->checksum[i]);
+	}
+	putchar('\n');
+#endif
+
+	return(status);
+}
@@ -0,0 +1,52 @@
+#include "precizer.h"
+
+/**
+ *
+ * Decide whether or not to skip the whole directory. It is
+ * skipped if every path beneath it matches PCRE2 regular
+ * expressions passed with --ignore= and none of them could
+ * be included back with --include=. Then the traversal
+ * doesn't even descend into the directory
+ *
+ */
+bool ignore_directory
+(
+	const char *relative_path
+){
+	bool skip = false;
+
+	if(config->ignore_regexp == NULL)
+	{
+		// Nothing to ignore
+		return(skip);
+	}
+
+	// All paths beneath start with "relative_path/"
+	size_t size = strlen(relative_path);
+
+	char *directory = (char *)malloc(size + 2);
+	if(directory == NULL)
+	{
+		// Just descend into the directory
+		return(skip);
+	}
+
+	memcpy(directory,relative_path,size);
+	directory[size] = '/';
+	directory[size + 1] = '\0';
+
+	if(regexp_match_every_path_in(config->ignore_regexp,directory) == true)
+	{
+		skip = true;
+
+		if(config->include_regexp != NULL
+			&& regexp_could_match_any_path_in(config->include_regexp,directory) == true)
+		{
+			skip = false;
+		}
+	}
+
+	free(directory);
+
+	return(skip);
+}
@@ -12,26 +12,23 @@ Include include
 	const char *relative_path,
 	bool *include_showed_once
 ){
-	if(config->include == NULL)
+	if(config->include_regexp == NULL)
 	{
 		// Nothing to include
 		return(DO_NOT_INCLUDE);
 	}
 
-	for(int i = 0; config->include[i] != NULL; ++i)
-	{
-		REGEXP result = regexp_match(config->include[i],relative_path,include_showed_once);
+	REGEXP result = regexp_match(config->include_regexp,relative_path,include_showed_once);
 
-		if(MATCH == result)
-		{
-			// Include that file
-			return(INCLUDE);
+	if(MATCH == result)
+	{
+		// Include that file
+		return(INCLUDE);
 
-		} else if(REGEXP_ERROR == result){
+	} else if(REGEXP_ERROR == result){
 
-			return(FAIL_REGEXP_INCLUDE);
+		return(FAIL_REGEXP_INCLUDE);
 
-		}
 	}
 
 	// Don't ignore the file
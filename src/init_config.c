@@ -18,6 +18,9 @@ void init_config(void)
 	// The pointer to the main database
 	config->db = NULL;
 
+	// Statements prepared once for all files
+	memset(&config->statements,0,sizeof(Statements));
+
 	// Total size of all scanned files
 	config->total_size_in_bytes = 0;
 
@@ -46,6 +49,13 @@ void init_config(void)
 	// An array of paths to traverse
 	config->paths = NULL;
 
+	// IDs of paths passed as arguments against the
+	// table 'paths' in the same order. Every file is
+	// saved against the ID of the path it was found in
+	config->path_prefix_indexes = NULL;
+	config->path_files = NULL;
+	config->path_size_in_bytes = NULL;
+
 	// The path of DB file
 	config->db_file_path = NULL;
 
@@ -84,6 +94,12 @@ void init_config(void)
 	// The string array of PCRE2 regular expressions
 	config->include = NULL;
 
+	// Compiled regular expressions of --ignore
+	config->ignore_regexp = NULL;
+
+	// Compiled regular expressions of --include
+	config->include_regexp = NULL;
+
 	// Must be specified additionally in order
 	// to remove from the database mention of
 	// files that matches the regular expression
@@ -95,4 +111,76 @@ void init_config(void)
 	// Perform a trial run with no changes made
 	config->dry_run = false;
 
+	// Number of hashing workers. The value 0 means
+	// that files will be hashed one by one right
+	// inside the traversal loop
+	config->threads = 0;
+
+	// Hash algorithm for new and changed files
+	config->hash_algorithm = HASH_SHA512;
+
+	// The algorithm has been chosen with --hash.
+	// Files hashed with another algorithm
+	// will be rehashed then
+	config->hash_algorithm_specified = false;
+
+	// Files of this size and bigger are hashed as a tree
+	// of chunks by all workers at once. The value 0 means
+	// that files are always hashed as a whole
+	config->tree_hash_size = 0;
+
+	// How reading of files affects the page cache.
+	// Set with --cache-mode
+	config->cache_mode = CACHE_DEFAULT;
+
+	// Save the state of a file being hashed against
+	// the DB every that many bytes. The value 0 means
+	// that the state is saved only on interruption
+	config->checkpoint_bytes = 0;
+
+	// Save the state of a file being hashed against
+	// the DB every that many seconds. The value 0 means
+	// that the state is saved only on interruption
+	config->checkpoint_seconds = 0;
+
+	// Number of threads that read directories in
+	// parallel. The value 0 means that the hierarchy
+	// is walked by fts in a single thread
+	config->traversal_threads = 0;
+
+	// Load metadata of all files saved against
+	// the DB into memory at once
+	config->preload = false;
+
+	// Metadata loaded with --preload
+	config->preloaded = NULL;
+
+	// Rows written against the DB in one
+	// transaction before it is committed
+	config->batch_size = 10000;
+
+	// Journaling and syncs of the DB.
+	// Set with --durability
+	config->durability = DURABILITY_OFF;
+
+	// How thoroughly the integrity of the DB
+	// is checked. Set with --db-check
+	config->db_check = DB_CHECK_FULL;
+
+	// Runs since the last full integrity check
+	// of the DB with --db-check=auto
+	config->db_check_runs = 0;
+
+	// The DB is checked in full this time
+	config->db_check_full = true;
+
+	// Number of the current scan. Files saved against
+	// the DB are stamped with it when seen
+	config->generation = 0;
+
+	// The database is brand new. Files are written
+	// without lookups against it and indexed after
+	// all of them have been loaded
+	config->bulk_load = false;
+
 }
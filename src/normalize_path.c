@@ -0,0 +1,63 @@
+#include "precizer.h"
+
+/**
+ *
+ * Bring a path to a single form, so the same directory is
+ * always saved as the same prefix: repeated slashes, components
+ * "." and the trailing slash are removed. Components ".." are
+ * kept as they are, because their meaning depends on symlinks.
+ * The path is changed in place
+ *
+*/
+void normalize_path
+(
+	char* path
+){
+	const bool absolute = path[0] == '/';
+
+	const char *read = path;
+	char *write = path;
+
+	if(absolute == true)
+	{
+		*write++ = '/';
+	}
+
+	while(*read != '\0')
+	{
+		while(*read == '/')
+		{
+			read++;
+		}
+
+		const char *component = read;
+
+		while(*read != '\0' && *read != '/')
+		{
+			read++;
+		}
+
+		size_t length = (size_t)(read - component);
+
+		if(length == 0 || (length == 1 && component[0] == '.'))
+		{
+			continue;
+		}
+
+		if(write > path && write[-1] != '/')
+		{
+			*write++ = '/';
+		}
+
+		memmove(write,component,length);
+		write += length;
+	}
+
+	if(write == path)
+	{
+		// Nothing but "." components
+		*write++ = '.';
+	}
+
+	*write = '\0';
+}
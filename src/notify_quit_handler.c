@@ -15,6 +15,13 @@ void notify_quit_handler
 ){
 	printf("Notify quit!\n");
 	global_interrupt_flag = true;
+
+	/* Stop a long statement right away */
+	sqlite3 *db = global_interruptible_db;
+	if(db != NULL)
+	{
+		sqlite3_interrupt(db);
+	}
 	if (sig==SIGTERM){
 		printf("Terminating the application. Please wait while the database will be closed smoothly...\n");
 	}
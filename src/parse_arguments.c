@@ -1,5 +1,6 @@
 #include "precizer.h"
 #include <argp.h>
+#include <limits.h>
 
 /**
  *
@@ -43,10 +44,12 @@ static char doc[] =
 "\n" \
 "Note that precizer writes only relative paths to the database. The example file “/mnt1/abc/def/aaa.txt” will be written to the database as “abc/def/aaa.txt” without /mnt1. The same thing will happen with the file “/mnt2/abc/def/aaa.txt”. Despite different mount points and different sources the files can be compared with each other under the same names “abc/def/aaa.txt” with the corresponding checksums.\n" \
 "\n" \
+"Several PATHs could be traversed at once. Every file is saved against the PATH it has been found in, and databases are compared PATH by PATH in the order PATHs have been passed.\n" \
+"\n" \
 "All other technical details could be found in README file of the project";
 
 /* A description of the arguments we accept. */
-static char args_doc[] = "PATH";
+static char args_doc[] = "PATH...";
 
 /* The options we understand. */
 static struct argp_option options[] = {
@@ -58,7 +61,12 @@ static struct argp_option options[] = {
 	                                     "understand what a relative path looks like, just " \
 	                                     "run traverses without the \033[1m--ignore\033[0m option " \
 	                                     "and look how the terminal will display relative paths " \
-	                                     "that are written to the database.\n" \
+	                                     "that are written to the database. Directories where " \
+	                                     "every path would be ignored and nothing could be " \
+	                                     "included back with \033[1m--include\033[0m are not " \
+	                                     "traversed at all, so a pattern like " \
+	                                     "\033[1m--ignore=\"^node_modules/\"\033[0m saves " \
+	                                     "reading of the whole subtree.\n" \
 	                                     "\nExamples:\n" \
 	                                     "\n\033[1m--ignore=\"diff2/1/*\" tests/examples/diffs\033[0m\n" \
 	                                     "\n" \
@@ -89,7 +97,8 @@ static struct argp_option options[] = {
 	                        "\033[1m--maxdepth=0\033[0m completely disable recursion\n", 0 },
 	{"force",    'f', 0, 0, "Use this option only in case when the PATHs that were written into " \
 	                        "the database as a result of the last scanning really need to be " \
-	                        "renewed. Warning! If this option will be used in incorrect way, " \
+	                        "renewed. Renewed PATHs take over files of replaced ones in the order " \
+	                        "they have been passed. Warning! If this option will be used in incorrect way, " \
 	                        "information about files and their checksums against the database would " \
 	                        "be lost.\n", 0 },
 	{"update",   'u', 0, 0, "Force update of the database with new, changed and deleted files. "\
@@ -103,19 +112,133 @@ static struct argp_option options[] = {
 	                         "old data will be deleted from the database and completely " \
 	                         "overwritten by new ones.\n", 0 },
 	{"database", 'd', "FILE", 0, "Database file name. By default name of the local host will be used: ${HOST}.db\n", 0 },
+	{"threads",  't', "NUMBER", 0, "Number of workers that calculate checksums in parallel. " \
+	                        "The traversal of the file hierarchy only prepares files for hashing " \
+	                        "while the workers read and hash them. Useful for fast storage " \
+	                        "like NVMe arrays. By default files are hashed one by one " \
+	                        "right inside the traversal\n", 0 },
+	{"hash",     'H', "NAME", 0, "Hash algorithm: \033[1mSHA512\033[0m (by default) or \033[1mBLAKE3\033[0m. " \
+	                        "BLAKE3 is several times faster and is enough to reveal synchronization " \
+	                        "errors. The algorithm is saved against the database for every file. " \
+	                        "Without this option files already saved against the database keep their " \
+	                        "algorithm and new files get the one most used in the database. With this " \
+	                        "option files hashed with another algorithm will be rehashed on " \
+	                        "\033[1m--update\033[0m\n", 0 },
+	{"tree-hash", 'T', "SIZE", 0, "Hash files of SIZE bytes and bigger as a tree of 64MB chunks. " \
+	                        "Chunks of the same file are hashed by all \033[1m--threads\033[0m at once, " \
+	                        "so a single huge file like a VM image is read and hashed as fast as " \
+	                        "the storage and all cores allow. The suffixes K, M, G and T could be " \
+	                        "used: \033[1m--tree-hash=16G\033[0m. The minimum is 64M. " \
+	                        "The checksum of a tree differs from the checksum of the whole file, " \
+	                        "so databases to be compared should be built with the same option. " \
+	                        "An interrupted file is resumed without rehashing of finished chunks\n", 0 },
+	{"cache-mode", 'M', "MODE", 0, "How reading of files affects the page cache of the host: " \
+	                        "\033[1mdefault\033[0m leaves all read data in the cache, " \
+	                        "\033[1mdirect\033[0m reads files with O_DIRECT bypassing the cache and " \
+	                        "\033[1mdontneed\033[0m drops data from the cache right after hashing. " \
+	                        "Useful on production servers where a scan of the whole storage " \
+	                        "would evict the cache of other services\n", 0 },
+	{"checkpoint-every", 'k', "SIZE|SECONDS", 0, "Save the state of a file being hashed against the " \
+	                        "database every SIZE bytes or every SECONDS seconds, not only on Ctrl+C. " \
+	                        "Hashing of a huge file is resumed from the last checkpoint even after " \
+	                        "the program has been killed or the host has lost power. The suffixes " \
+	                        "K, M, G and T set a size and the suffix s sets seconds: " \
+	                        "\033[1m--checkpoint-every=10G\033[0m or \033[1m--checkpoint-every=300s\033[0m\n", 0 },
+	{"traversal-threads", 'r', "N", 0, "Number of threads that read directories of the " \
+	                        "file hierarchy in parallel. Useful on network file systems like NFS " \
+	                        "or Lustre, where listing of directories is bound by the latency of " \
+	                        "every call. Files are reported in no particular order then. By default " \
+	                        "the hierarchy is walked by a single thread in the same order as always\n", 0 },
+	{"preload",  'P', 0, 0, "Load metadata of all files saved against the database into memory " \
+	                        "at once. Then unchanged files are skipped without a query to the " \
+	                        "database for every file. Useful when the database contains millions " \
+	                        "of files and only a few of them change between runs. Takes about " \
+	                        "a hundred bytes of memory plus the length of the path for every file\n", 0 },
+	{"batch-size", 'b', "NUMBER", 0, "Number of rows written against the database in one " \
+	                        "transaction. A transaction is committed every NUMBER rows or every " \
+	                        "second, whichever comes first, and on interruption. Bigger batches " \
+	                        "mean fewer writes to the database file. By default 10000\n", 0 },
+	{"durability", 'D', "LEVEL", 0, "What a crash or a power loss during writing could do to " \
+	                        "the database: \033[1moff\033[0m (by default) writes without a journal and " \
+	                        "without syncs, the fastest, but the database could be corrupted and " \
+	                        "then all files have to be hashed again; \033[1mnormal\033[0m writes through " \
+	                        "a write-ahead log (WAL), the database is never corrupted and at most " \
+	                        "the last transactions are lost; \033[1mfull\033[0m also syncs every " \
+	                        "transaction, nothing committed is lost. With WAL the database could be " \
+	                        "read, for example with \033[1m--compare\033[0m, while a scan writes it\n", 0 },
+	{"db-check", 'I', "MODE", 0, "How thoroughly the integrity of databases is checked before use: " \
+	                        "\033[1mfull\033[0m (by default) runs the full check every time, " \
+	                        "\033[1mquick\033[0m runs the quicker check that doesn't verify indexes, " \
+	                        "\033[1moff\033[0m skips the check and \033[1mauto\033[0m runs the quick check " \
+	                        "if the database file has not been touched since the last run, and the " \
+	                        "full check after a crash, a change from outside and every tenth run. " \
+	                        "With \033[1mauto\033[0m the state of the database file is saved into " \
+	                        "the file with the suffix -check next to it\n", 0 },
 	{ 0, 0, 0, 0, "Compare databases options:", 1},
 	{"compare",  'c', 0, 0, "Compare two databases from different sourses. Two extra arguments should be " \
 	                        "specified as paths to the databases files to compare. For example: \033[1m--compare database1.db database2.db\033[0m\n", 0 },
 	{ 0, 0, 0, 0, "Visualizations options:\n", -1},
 	{"silent",   's', 0, 0, "Don't produce any output. The option will not affect \033[1m--compare\033[0m", 0 },
 	{"verbose",  'v', 0, 0, "Produce verbose output.", 0 },
-	{"progress", 'p', 0, 0, "Show progress bar. This assume a preliminary count of files and the space they occupy " \
-	                        "to predict execution time. It is strongly recommended not to specify this option " \
-	                        "if the program is called from a script. This will reduce execution time " \
-	                        "(sometimes significantly) and reduce screen output.", 0 },
+	{"progress", 'p', 0, 0, "Show progress bar. The number of files and the space they occupy are " \
+	                        "estimated from the previous run saved against the database to predict " \
+	                        "execution time, so the file hierarchy is still walked only once. " \
+	                        "It is strongly recommended not to specify this option " \
+	                        "if the program is called from a script. This will reduce screen output.", 0 },
 	{0}
 };
 
+/**
+ *
+ * Convert a size with an optional K, M, G or T suffix
+ * into bytes. Returns -1 if the string is not a size
+ *
+ */
+static long long int size_in_bytes
+(
+	const char *arg
+){
+	char *ptr = NULL;
+	long long int value = strtoll(arg, &ptr, 10);
+
+	if(ptr == arg || value < 0)
+	{
+		return(-1);
+	}
+
+	int shift = 0;
+
+	switch(*ptr)
+	{
+		case 'T':
+		case 't':
+			shift += 10;
+			// fall through
+		case 'G':
+		case 'g':
+			shift += 10;
+			// fall through
+		case 'M':
+		case 'm':
+			shift += 10;
+			// fall through
+		case 'K':
+		case 'k':
+			shift += 10;
+			ptr++;
+			break;
+		default:
+			break;
+	}
+
+	if(*ptr != '\0' || value > (LLONG_MAX >> shift))
+	{
+		return(-1);
+	}
+
+	return(value << shift);
+}
+
 /* Parse a single option. */
 static error_t parse_opt
 (
@@ -180,6 +303,135 @@ static error_t parse_opt
 		case 'p':
 			config->progress = true;
 			break;
+		case 't':
+			argument_value = strtol(arg, &ptr, 10);
+			// The argument contains a digit only
+			if(argument_value >= 1 && argument_value <= 1024 && *ptr == '\0')
+			{
+				config->threads = (unsigned short)argument_value;
+			} else {
+				argp_failure(state, 1, 0, "ERROR: Wrong --threads (-t) value. Should be an integer from 1 to 1024. See --help for more information");
+			}
+			break;
+		case 'b':
+			{
+				long long int rows = strtoll(arg, &ptr, 10);
+
+				// The argument contains a digit only
+				if(rows >= 1 && *ptr == '\0')
+				{
+					config->batch_size = (size_t)rows;
+				} else {
+					argp_failure(state, 1, 0, "ERROR: Wrong --batch-size (-b) value. Should be a positive integer. See --help for more information");
+				}
+			}
+			break;
+		case 'P':
+			config->preload = true;
+			break;
+		case 'r':
+			argument_value = strtol(arg, &ptr, 10);
+			// The argument contains a digit only
+			if(argument_value >= 1 && argument_value <= 1024 && *ptr == '\0')
+			{
+				config->traversal_threads = (unsigned short)argument_value;
+			} else {
+				argp_failure(state, 1, 0, "ERROR: Wrong --traversal-threads (-r) value. Should be an integer from 1 to 1024. See --help for more information");
+			}
+			break;
+		case 'H':
+			if(hash_algorithm_by_name(arg,&config->hash_algorithm) == true)
+			{
+				config->hash_algorithm_specified = true;
+			} else {
+				argp_failure(state, 1, 0, "ERROR: Unknown --hash (-H) algorithm. Should be SHA512 or BLAKE3. See --help for more information");
+			}
+			break;
+		case 'T':
+			{
+				long long int size = size_in_bytes(arg);
+
+				if(size >= TREE_CHUNK_SIZE)
+				{
+					config->tree_hash_size = (sqlite3_int64)size;
+				} else {
+					argp_failure(state, 1, 0, "ERROR: Wrong --tree-hash (-T) value. Should be a size of 64M or bigger. See --help for more information");
+				}
+			}
+			break;
+		case 'M':
+			if(strcmp(arg,"default") == 0)
+			{
+				config->cache_mode = CACHE_DEFAULT;
+			} else if(strcmp(arg,"direct") == 0)
+			{
+				config->cache_mode = CACHE_DIRECT;
+			} else if(strcmp(arg,"dontneed") == 0)
+			{
+				config->cache_mode = CACHE_DONTNEED;
+			} else {
+				argp_failure(state, 1, 0, "ERROR: Unknown --cache-mode (-M) value. Should be default, direct or dontneed. See --help for more information");
+			}
+			break;
+		case 'D':
+			if(strcmp(arg,"off") == 0)
+			{
+				config->durability = DURABILITY_OFF;
+			} else if(strcmp(arg,"normal") == 0)
+			{
+				config->durability = DURABILITY_NORMAL;
+			} else if(strcmp(arg,"full") == 0)
+			{
+				config->durability = DURABILITY_FULL;
+			} else {
+				argp_failure(state, 1, 0, "ERROR: Unknown --durability (-D) value. Should be off, normal or full. See --help for more information");
+			}
+			break;
+		case 'I':
+			if(strcmp(arg,"full") == 0)
+			{
+				config->db_check = DB_CHECK_FULL;
+			} else if(strcmp(arg,"quick") == 0)
+			{
+				config->db_check = DB_CHECK_QUICK;
+			} else if(strcmp(arg,"off") == 0)
+			{
+				config->db_check = DB_CHECK_OFF;
+			} else if(strcmp(arg,"auto") == 0)
+			{
+				config->db_check = DB_CHECK_AUTO;
+			} else {
+				argp_failure(state, 1, 0, "ERROR: Unknown --db-check (-I) value. Should be full, quick, off or auto. See --help for more information");
+			}
+			break;
+		case 'k':
+			{
+				size_t len = strlen(arg);
+
+				if(len > 1 && (arg[len - 1] == 's' || arg[len - 1] == 'S'))
+				{
+					long long int seconds = strtoll(arg, &ptr, 10);
+
+					if(ptr == arg + len - 1 && seconds > 0)
+					{
+						config->checkpoint_seconds = (time_t)seconds;
+						break;
+					}
+
+				} else {
+
+					long long int size = size_in_bytes(arg);
+
+					if(size > 0)
+					{
+						config->checkpoint_bytes = (sqlite3_int64)size;
+						break;
+					}
+				}
+
+				argp_failure(state, 1, 0, "ERROR: Wrong --checkpoint-every (-k) value. Should be a size like 10G or a number of seconds like 300s. See --help for more information");
+			}
+			break;
 		case 'u':
 			config->update = true;
 			break;
@@ -209,11 +461,6 @@ static error_t parse_opt
 				{
 					argp_failure(state, 1, 0, "ERROR: Too many arguments\n--compare require just two arguments with paths to database files. See --help for more information");
 				}
-			} else {
-				if(state->arg_num > 1)
-				{
-					argp_failure(state, 1, 0, "ERROR: Too many arguments\nOnly one PATH argument can be used for traversing file hierarchy. See --help for more information");
-				}
 			}
 			break;
 		default:
@@ -243,8 +490,14 @@ Return parse_arguments
 	{
 		for (int j = 0; config->paths[j]; j++)
 		{
-			// Remove unnecessary trailing slash at the end of the directory path
-			remove_trailing_slash(config->paths[j]);
+			if(config->compare == true)
+			{
+				// Remove unnecessary trailing slash at the end of the directory path
+				remove_trailing_slash(config->paths[j]);
+			} else {
+				// The same directory is always saved as the same prefix
+				normalize_path(config->paths[j]);
+			}
 		}
 	}
 
@@ -316,6 +569,16 @@ Return parse_arguments
 			}
 		printf("; ");
 		}
+		printf("threads=%u; ",config->threads);
+		printf("hash=%s; ",hash_algorithm_name(config->hash_algorithm));
+		printf("tree-hash=%lld; ",(long long int)config->tree_hash_size);
+		printf("cache-mode=%s; ",config->cache_mode == CACHE_DIRECT ? "direct" : config->cache_mode == CACHE_DONTNEED ? "dontneed" : "default");
+		printf("checkpoint-every=%lldB/%llds; ",(long long int)config->checkpoint_bytes,(long long int)config->checkpoint_seconds);
+		printf("traversal-threads=%u; ",config->traversal_threads);
+		printf("preload=%s; ",config->preload ? "yes" : "no");
+		printf("batch-size=%zu; ",config->batch_size);
+		printf("durability=%s; ",config->durability == DURABILITY_FULL ? "full" : config->durability == DURABILITY_NORMAL ? "normal" : "off");
+		printf("db-check=%s; ",config->db_check == DB_CHECK_QUICK ? "quick" : config->db_check == DB_CHECK_OFF ? "off" : config->db_check == DB_CHECK_AUTO ? "auto" : "full");
 		printf("verbose=%s; silent=%s; force=%s; update=%s; progress=%s; compare=%s, db-clean-ignored=%s, dry-run=%s",
 		config->verbose ? "yes" : "no",
 		config->silent ? "yes" : "no",
@@ -16,6 +16,11 @@
 // Atomic variable is very fast and will be called very often
 _Atomic bool global_interrupt_flag = false;
 
+// The database a long statement is running against that
+// could be stopped right away on interruption, like VACUUM.
+// NULL while interrupting of statements is not safe
+sqlite3 *_Atomic global_interruptible_db = NULL;
+
 // The global structure Config where all runtime settings will be stored
 Config _config;
 Config *config = &_config;
@@ -54,6 +59,19 @@ int main(int argc,char **argv){
 		status = detect_paths();
 	}
 
+	if(SUCCESS == status)
+	{
+		// Traverse every directory only once
+		status = remove_repeated_paths();
+	}
+
+	if(SUCCESS == status)
+	{
+		// Compile regular expressions of --ignore
+		// and --include once for all paths
+		status = regexp_init();
+	}
+
 	if(SUCCESS == status)
 	{
 		// Initialize signals interception like Ctrl+C
@@ -66,12 +84,26 @@ int main(int argc,char **argv){
 		status = db_create_name();
 	}
 
+	if(SUCCESS == status)
+	{
+		// Choose how thoroughly the database will be
+		// checked while its file is still untouched
+		status = db_test_choose();
+	}
+
 	if(SUCCESS == status)
 	{
 		// Initialize SQLite database
 		status = db_init();
 	}
 
+	if(SUCCESS == status)
+	{
+		// Compile SQL statements executed
+		// for every file only once
+		status = db_prepare_statements();
+	}
+
 	if(SUCCESS == status)
 	{
 		// Compare databases
@@ -93,7 +125,14 @@ int main(int argc,char **argv){
 	if(SUCCESS == status)
 	{
 		// Check up the integrity of database file
-		status = db_test(config->db_file_path);
+		status = db_test(config->db_file_path,config->db_check_full);
+	}
+
+	if(SUCCESS == status)
+	{
+		// The hash algorithm for new files if
+		// it was not specified explicitly
+		status = db_get_hash_algorithm();
 	}
 
 	if(SUCCESS == status)
@@ -110,6 +149,20 @@ int main(int argc,char **argv){
 		status = db_save_prefixes_into();
 	}
 
+	if(SUCCESS == status)
+	{
+		// Files seen by this scan will
+		// be stamped with a new number
+		status = db_start_generation();
+	}
+
+	if(SUCCESS == status)
+	{
+		// Files of a brand new database are loaded
+		// without lookups and indexed afterwards
+		status = db_bulk_load_begin();
+	}
+
 	if(SUCCESS == status)
 	{
 		// Check up the paths passed as arguments and make sure
@@ -119,14 +172,29 @@ int main(int argc,char **argv){
 
 	if(SUCCESS == status)
 	{
-		// Just get a statistic
-		status = file_list(true);
+		// Load metadata of all files saved against
+		// the DB at once if --preload has been specified
+		status = db_preload();
+	}
+
+	if(SUCCESS == status)
+	{
+		// Estimate totals from the previous run
+		// to show the progress against them
+		status = progress_init();
 	}
 
 	if(SUCCESS == status)
 	{
 		// Get file list and their CRC
-		status = file_list(false);
+		status = file_list();
+	}
+
+	if(SUCCESS == status)
+	{
+		// Index files loaded into a brand new
+		// database, also on interruption
+		status = db_bulk_load_end();
 	}
 
 	if(SUCCESS == status)
@@ -150,6 +218,16 @@ int main(int argc,char **argv){
 		status_of_changes();
 	}
 
+	if(SUCCESS == status || WARNING == status)
+	{
+		// Remember the state of the database file
+		// for the next run with --db-check=auto
+		if(SUCCESS != db_test_save_state())
+		{
+			status = FAILURE;
+		}
+	}
+
 	// Free allocated memory
 	// for arrays and variables
 	free_config();
@@ -11,6 +11,7 @@
 /// Included libraries from "libs" subdir
 #include "rational.h"
 #include "sha512.h"
+#include "blake3.h"
 #include "sqlite3.h"
 
 
@@ -25,6 +26,22 @@
 
 #define SHA512_DIGEST_LENGTH 64
 
+/// The longest checksum of all supported hash algorithms
+#define MAX_DIGEST_LENGTH SHA512_DIGEST_LENGTH
+
+/// Huge files hashed as a tree are split into chunks of this size.
+/// The size is a part of the checksum, so never change it
+#define TREE_CHUNK_SIZE (64 * 1024 * 1024)
+
+/// How many chunks ahead of the first unfinished one
+/// could be hashed at once
+#define TREE_WINDOW 64
+
+/// Rows written against the DB are committed not
+/// later than that many ms after the transaction
+/// has been begun, even if nothing else is written
+#define TRANSACTION_INTERVAL_MS 1000LL
+
 /*
  *
  * Initialization of enumerations
@@ -58,6 +75,30 @@ typedef enum
 
 } REGEXP;
 
+// PCRE2 regular expressions compiled once for all paths
+typedef struct Regexp Regexp;
+
+// Metadata of all files saved against the DB loaded at once
+typedef struct Preload Preload;
+
+/* SQL statements executed for every file.
+ * Prepared once right after the DB has been opened */
+typedef struct {
+
+	/// Read data about a file by its relative path
+	sqlite3_stmt *select_file;
+
+	/// Insert a new file
+	sqlite3_stmt *insert_file;
+
+	/// Update a file by its ID
+	sqlite3_stmt *update_file;
+
+	/// Stamp a file seen by the current scan by its ID
+	sqlite3_stmt *stamp_file;
+
+} Statements;
+
 // Return codes for Ignore function
 typedef enum
 {
@@ -91,6 +132,82 @@ typedef enum
 
 } Changed;
 
+/*
+ * Hash algorithms. The number is saved against
+ * the DB for every file, so never renumber them
+ *
+ */
+typedef enum
+{
+    HASH_SHA512 = 1,
+    HASH_BLAKE3 = 2,
+
+    /* The same algorithms applied to a tree of chunks */
+    HASH_SHA512_TREE = 3,
+    HASH_BLAKE3_TREE = 4
+
+} HashAlgorithm;
+
+/*
+ * How reading of files affects the page cache
+ *
+ */
+typedef enum
+{
+    /* Pages stay in the cache as usual */
+    CACHE_DEFAULT  = 0,
+
+    /* O_DIRECT reads bypass the cache */
+    CACHE_DIRECT   = 1,
+
+    /* Pages are dropped right after hashing */
+    CACHE_DONTNEED = 2
+
+} CacheMode;
+
+/*
+ * How a crash or a power loss during
+ * writing could affect the database
+ *
+ */
+typedef enum
+{
+    /* No journal and no syncs. A crash
+     * could corrupt the database */
+    DURABILITY_OFF    = 0,
+
+    /* WAL with syncs at checkpoints. The database is
+     * never corrupted, the last commits could be lost */
+    DURABILITY_NORMAL = 1,
+
+    /* WAL with a sync at every commit.
+     * Nothing committed could be lost */
+    DURABILITY_FULL   = 2
+
+} Durability;
+
+/*
+ * How thoroughly the integrity of
+ * a database is checked before use
+ *
+ */
+typedef enum
+{
+    /* PRAGMA integrity_check every time */
+    DB_CHECK_FULL  = 0,
+
+    /* PRAGMA quick_check every time */
+    DB_CHECK_QUICK = 1,
+
+    /* No check at all */
+    DB_CHECK_OFF   = 2,
+
+    /* The quick check if the database has not been
+     * touched since the last run, the full one otherwise */
+    DB_CHECK_AUTO  = 3
+
+} DbCheck;
+
 /*
  * A file or a directory
  *
@@ -108,6 +225,45 @@ typedef enum
  *
  */
 
+/* Intermediate state of hashing of any supported algorithm.
+ * Saved against the DB when hashing of a file was interrupted */
+typedef union {
+
+	SHA512_Context sha512;
+
+	blake3_hasher blake3;
+
+} HashContext;
+
+/* Intermediate state of a file hashed as a tree. Chunks are
+ * hashed independently and their checksums are passed in order
+ * through the root hash of the same algorithm */
+typedef struct {
+
+	/* State of the root hash */
+	HashContext root;
+
+	/* Number of chunks already passed through the root hash */
+	uint64_t hashed;
+
+	/* Chunks finished ahead of the first unfinished one.
+	 * Bit i stands for the chunk number hashed + i */
+	uint64_t ahead;
+
+	/* Checksums of the chunks finished ahead */
+	unsigned char ahead_checksums[TREE_WINDOW][MAX_DIGEST_LENGTH];
+
+} TreeContext;
+
+/* Everything that is needed to resume hashing of a file */
+typedef union {
+
+	HashContext plain;
+
+	TreeContext tree;
+
+} HashState;
+
 /* DB row content */
 typedef struct {
 
@@ -123,11 +279,170 @@ typedef struct {
 	/* Metadata of a file (man 2 stat) */
 	struct stat saved_stat;
 
-	/* SHA512 metadata */
-	SHA512_Context saved_mdContext;
+	/* Hash algorithm the checksum has been calculated with */
+	HashAlgorithm saved_algorithm;
+
+	/* Hashing state */
+	HashState saved_mdContext;
 
 } DBrow;
 
+/* A file that has to be hashed and then saved against the DB */
+typedef struct HashJob {
+
+	/* Relative path of the file as it will be written into DB */
+	char *relative_path;
+
+	/* ID of the path passed as an argument the file has been
+	 * found in. The ID is written into DB with the file */
+	sqlite3_int64 path_prefix_index;
+
+	/* Path of the file to show in messages */
+	char *path;
+
+	/* The file opened by the traversal. -1 for
+	 * zero-length files, they are never opened */
+	int fd;
+
+	/* The file has been opened with O_DIRECT */
+	bool direct;
+
+	/* Metadata of a file (man 2 stat) */
+	struct stat stat;
+
+	/* DB row content saved against the database */
+	DBrow dbrow;
+
+	/* Code of changes in file metadata */
+	int metadata_of_scanned_and_saved_files;
+
+	/* Offset of a file the hashing has been stopped at */
+	sqlite3_int64 offset;
+
+	/* Hash algorithm of the job */
+	HashAlgorithm algorithm;
+
+	/* Hashing state */
+	HashState mdContext;
+
+	/* Number of bytes starting from the offset if the job is
+	 * a chunk of a file hashed as a tree. 0 for a whole file */
+	sqlite3_int64 length;
+
+	/* Number of the chunk within the file */
+	uint64_t chunk;
+
+	/* Resulting checksum */
+	unsigned char checksum[MAX_DIGEST_LENGTH];
+
+	/* True if the job has never been started because of interruption */
+	bool skipped;
+
+	/* A checkpoint of the job that waits in the pool
+	 * to be written into DB. Protected by the pool */
+	struct HashJob *checkpoint;
+
+	/* The job this checkpoint has been taken from.
+	 * NULL for jobs that are not checkpoints */
+	struct HashJob *origin;
+
+	/* Exit status of the hashing */
+	Return status;
+
+	/* Next job in a queue */
+	struct HashJob *next;
+
+} HashJob;
+
+/* Types of file system objects found by the traversal */
+typedef enum {
+
+	ENTRY_FILE,
+	ENTRY_DIRECTORY,
+	ENTRY_SYMLINK,
+	ENTRY_OTHER
+
+} EntryType;
+
+/* A file system object found by the traversal */
+typedef struct {
+
+	/* Type of the object */
+	EntryType type;
+
+	/* Path starting with the path passed as an argument */
+	char *path;
+
+	/* Relative path as it will be written into DB.
+	 * Empty for paths passed as arguments */
+	const char *relative_path;
+
+	/* The directory the object could be opened from */
+	int dirfd;
+
+	/* Name of the object to open relative to dirfd */
+	const char *name;
+
+	/* Depth of the object. Paths passed as arguments are 0 */
+	short level;
+
+	/* Index of the path passed as an argument
+	 * the object has been found in */
+	size_t root;
+
+	/* Metadata of the object (man 2 lstat) */
+	struct stat stat;
+
+	/* The directory is ignored as a whole
+	 * and will not be traversed */
+	bool ignored;
+
+} TraversalEntry;
+
+/* The moment the state of a file has been saved last time */
+typedef struct {
+
+	/* Offset of the file at the moment */
+	sqlite3_int64 offset;
+
+	/* Time of the moment */
+	struct timespec time;
+
+} Checkpoint;
+
+/* A file opened for hashing */
+typedef struct {
+
+	/* File descriptor */
+	int fd;
+
+	/* Path to show in messages */
+	const char *path;
+
+	/* Offset of the next byte to be handed out */
+	sqlite3_int64 offset;
+
+	/* Offset of the next read to be requested */
+	sqlite3_int64 requested;
+
+	/* Offset to stop reading at. 0 means the end of file */
+	sqlite3_int64 end;
+
+	/* Size of the file when it has been opened */
+	sqlite3_int64 size;
+
+	/* The file has been opened with O_DIRECT */
+	bool direct;
+
+	/* Pages of the file before this offset
+	 * have been dropped from the page cache */
+	sqlite3_int64 dropped;
+
+	/* The end of file has been reached */
+	bool eof;
+
+} FileReader;
+
 // The main Configuration
 typedef struct {
 
@@ -137,6 +452,9 @@ typedef struct {
 	/// The pointer to the main database
 	sqlite3 *db;
 
+	/// Statements prepared once for all files
+	Statements statements;
+
 	/// Total size of all scanned files
 	size_t total_size_in_bytes;
 
@@ -165,6 +483,17 @@ typedef struct {
 	/// An array of paths to traverse
 	char **paths;
 
+	/// IDs of paths passed as arguments against the
+	/// table 'paths' in the same order. Every file is
+	/// saved against the ID of the path it was found in
+	sqlite3_int64 *path_prefix_indexes;
+
+	/// Number and total size of files found under every
+	/// path passed as an argument by this run in the same
+	/// order. Saved as the estimate for the next --progress
+	size_t *path_files;
+	size_t *path_size_in_bytes;
+
 	/// The path of DB file
 	char *db_file_path;
 
@@ -203,6 +532,12 @@ typedef struct {
 	/// The string array of PCRE2 regular expressions
 	char **include;
 
+	/// Compiled regular expressions of --ignore
+	Regexp *ignore_regexp;
+
+	/// Compiled regular expressions of --include
+	Regexp *include_regexp;
+
 	/// Must be specified additionally in order
 	/// to remove from the database mention of
 	/// files that matches the regular expression
@@ -214,6 +549,78 @@ typedef struct {
 	/// Perform a trial run with no changes made
 	bool dry_run;
 
+	/// Number of hashing workers. The value 0 means
+	/// that files will be hashed one by one right
+	/// inside the traversal loop
+	unsigned short threads;
+
+	/// Hash algorithm for new and changed files
+	HashAlgorithm hash_algorithm;
+
+	/// The algorithm has been chosen with --hash.
+	/// Files hashed with another algorithm
+	/// will be rehashed then
+	bool hash_algorithm_specified;
+
+	/// Files of this size and bigger are hashed as a tree
+	/// of chunks by all workers at once. The value 0 means
+	/// that files are always hashed as a whole
+	sqlite3_int64 tree_hash_size;
+
+	/// How reading of files affects the page cache.
+	/// Set with --cache-mode
+	CacheMode cache_mode;
+
+	/// Save the state of a file being hashed against
+	/// the DB every that many bytes. The value 0 means
+	/// that the state is saved only on interruption
+	sqlite3_int64 checkpoint_bytes;
+
+	/// Save the state of a file being hashed against
+	/// the DB every that many seconds. The value 0 means
+	/// that the state is saved only on interruption
+	time_t checkpoint_seconds;
+
+	/// Number of threads that read directories in
+	/// parallel. The value 0 means that the file
+	/// hierarchy is walked by fts with one thread
+	unsigned short traversal_threads;
+
+	/// Load metadata of all files saved against
+	/// the DB into memory at once
+	bool preload;
+
+	/// Metadata loaded with --preload
+	Preload *preloaded;
+
+	/// Rows written against the DB in one
+	/// transaction before it is committed
+	size_t batch_size;
+
+	/// Journaling and syncs of the DB.
+	/// Set with --durability
+	Durability durability;
+
+	/// How thoroughly the integrity of the DB
+	/// is checked. Set with --db-check
+	DbCheck db_check;
+
+	/// Runs since the last full integrity check
+	/// of the DB with --db-check=auto
+	unsigned int db_check_runs;
+
+	/// The DB is checked in full this time
+	bool db_check_full;
+
+	/// Number of the current scan. Files saved against
+	/// the DB are stamped with it when seen
+	sqlite3_int64 generation;
+
+	/// The database is brand new. Files are written
+	/// without lookups against it and indexed after
+	/// all of them have been loaded
+	bool bulk_load;
+
 } Config;
 
 /*
@@ -222,16 +629,135 @@ typedef struct {
  *
  */
 
-Return file_list(
-	bool
+Return file_list(void);
+
+Return traversal_init(void);
+
+Return traversal_next(
+	TraversalEntry**
+);
+
+void traversal_free(void);
+
+Return hashsum(
+	HashJob*
+);
+
+Return file_reader_prepare(
+	HashJob*,
+	int,
+	const char*
+);
+
+Return file_reader_open(
+	FileReader*,
+	const HashJob*
 );
 
-Return sha512sum(
+Return file_reader_next(
+	FileReader*,
+	const unsigned char**,
+	size_t*
+);
+
+void file_reader_close(
+	FileReader*
+);
+
+void file_reader_free(void);
+
+Return tree_hash(
+	HashJob*
+);
+
+Return tree_hash_chunk(
+	HashJob*
+);
+
+Return hash_init(
+	HashAlgorithm,
+	HashContext*
+);
+
+Return hash_update(
+	HashAlgorithm,
+	HashContext*,
+	const unsigned char*,
+	size_t
+);
+
+Return hash_final(
+	HashAlgorithm,
+	HashContext*,
+	unsigned char*
+);
+
+size_t hash_digest_length(
+	HashAlgorithm
+) __attribute__ ((const));
+
+size_t hash_context_size(
+	HashAlgorithm
+) __attribute__ ((const));
+
+const char *hash_algorithm_name(
+	HashAlgorithm
+) __attribute__ ((const));
+
+bool hash_is_tree(
+	HashAlgorithm
+) __attribute__ ((const));
+
+HashAlgorithm hash_tree_of(
+	HashAlgorithm
+) __attribute__ ((const));
+
+HashAlgorithm hash_plain_of(
+	HashAlgorithm
+) __attribute__ ((const));
+
+bool hash_algorithm_by_name(
 	const char*,
-	const short unsigned int*,
-	unsigned char*,
-	sqlite3_int64*,
-	SHA512_Context*
+	HashAlgorithm*
+);
+
+Return hashing_pool_init(void);
+
+Return hashing_pool_submit(
+	HashJob*
+);
+
+HashJob *hashing_pool_done(
+	bool
+);
+
+bool hashing_pool_is_full(void);
+
+Return hashing_pool_checkpoint(
+	HashJob*
+);
+
+void hashing_pool_free(void);
+
+void free_hash_job(
+	HashJob*
+);
+
+void checkpoint_start(
+	Checkpoint*,
+	sqlite3_int64
+);
+
+bool checkpoint_is_due(
+	Checkpoint*,
+	sqlite3_int64
+);
+
+Return progress_init(void);
+
+void progress_update(
+	size_t,
+	size_t
 );
 
 void add_string_to_array(
@@ -241,6 +767,8 @@ void add_string_to_array(
 
 void remove_trailing_slash(char*);
 
+void normalize_path(char*);
+
 size_t correction(char*) __attribute__ ((pure));
 
 void notify_quit_handler(int);
@@ -255,37 +783,128 @@ void free_config(void);
 
 Return db_delete_missing_files_from(void);
 
-Return db_delete_the_file_by_id
+Return db_stamp_the_record
 (
-	sqlite_int64*,
-	bool*,
-	const bool*,
-	const char*
+	const sqlite3_int64*
 );
 
+Return db_start_generation(void);
+
 Return db_init(void);
 
+Return db_upgrade(void);
+
+Return db_get_hash_algorithm(void);
+
+Return db_estimate_totals(
+	size_t*,
+	size_t*
+);
+
+Return db_save_totals(void);
+
+Return db_preload(void);
+
+Return db_prepare_statements(void);
+
+Return db_transaction_begin(void);
+
+Return db_transaction_end(void);
+
+Return db_transaction_flush(void);
+
+Return db_transaction_written(void);
+
+Return db_transaction_commit_due(void);
+
+Return db_bulk_load_begin(void);
+
+Return db_bulk_load_end(void);
+
+Return db_writer_init(void);
+
+Return db_writer_submit(
+	HashJob*
+);
+
+Return db_writer_stamp(
+	const sqlite3_int64*
+);
+
+void db_writer_lock(void);
+
+void db_writer_unlock(void);
+
+Return db_writer_commit_due(void);
+
+Return db_writer_free(void);
+
+Return db_reader_open(void);
+
+sqlite3_stmt *db_reader_take(void);
+
+void db_reader_give_back(
+	sqlite3_stmt*
+);
+
+void db_reader_close(void);
+
+void db_release_statement(
+	sqlite3_stmt*
+);
+
+void db_finalize_statements(void);
+
+bool db_preload_lookup(
+	DBrow*,
+	const sqlite3_int64*,
+	const char*
+);
+
+bool db_preload_totals(
+	size_t*,
+	size_t*
+);
+
+void db_preload_free(
+	Preload*
+);
+
 Return db_vacuum(void);
 
 Return db_read_file_data_from(
 	DBrow*,
+	const sqlite3_int64*,
 	const char*
 );
 
 Return db_update_the_record(
 	const sqlite3_int64*,
 	const sqlite3_int64*,
+	HashAlgorithm,
 	const unsigned char*,
 	const struct stat*,
-	const SHA512_Context*
+	const HashState*
 );
 
 Return db_insert_the_record(
+	const sqlite3_int64*,
 	const char*,
 	const sqlite3_int64*,
+	HashAlgorithm,
 	const unsigned char*,
 	const struct stat*,
-	const SHA512_Context*
+	const HashState*
+);
+
+Return db_write_the_result(
+	const HashJob*
+);
+
+Return db_save_checkpoint(
+	HashJob*,
+	sqlite3_int64,
+	const HashState*
 );
 
 Return db_create_name(void);
@@ -299,16 +918,18 @@ Return db_check_up_paths(void);
 Return db_already_exists(void);
 
 Return db_test(
-	const char*
+	const char*,
+	bool
 );
 
-#if 0 // Old multiPATH solution
-Return db_get_path_prefix_index
-(
+bool db_test_in_full(
 	const char*,
-	sqlite3_int64*
+	unsigned int*
 );
-#endif
+
+Return db_test_choose(void);
+
+Return db_test_save_state(void);
 
 int compare_file_metadata_equivalence(
 	const struct stat*,
@@ -325,6 +946,7 @@ void show_relative_path
 	const char*,
 	const int*,
 	const DBrow*,
+	const HashAlgorithm*,
 	const struct stat*,
 	bool*,
 	bool*,
@@ -342,6 +964,8 @@ Return detect_a_path(
 
 Return detect_paths(void);
 
+Return remove_repeated_paths(void);
+
 Ignore ignore(
 	const char*,
 	bool*
@@ -352,13 +976,37 @@ Include include(
 	bool*
 );
 
-REGEXP regexp_match
-(
-	const char*,
+Return regexp_compile(
+	char**,
+	Regexp**
+);
+
+REGEXP regexp_match(
+	const Regexp*,
 	const char*,
 	bool*
 );
 
+bool regexp_match_every_path_in(
+	const Regexp*,
+	const char*
+);
+
+bool regexp_could_match_any_path_in(
+	const Regexp*,
+	const char*
+);
+
+void regexp_free(
+	Regexp*
+);
+
+bool ignore_directory(
+	const char*
+);
+
+Return regexp_init(void);
+
 int exit_status(
 	Return,
 	char**
@@ -381,6 +1029,8 @@ char *logger_show_time(void);
 
 extern _Atomic bool global_interrupt_flag;
 
+extern sqlite3 *_Atomic global_interruptible_db;
+
 extern Config _config;
 extern Config *config;
 
@@ -0,0 +1,128 @@
+#include "precizer.h"
+
+/**
+ *
+ * @file progress.c
+ * @brief Progress of the traversal shown with --progress
+ * @details The file hierarchy is walked only once. The totals
+ * to compare the progress against are estimated from files saved
+ * against the database by the previous run, so the progress and
+ * the time left are shown right away, while the exact totals are
+ * known only at the end of the walk.
+ *
+ */
+
+// Show the progress not more often than once a second
+#define PROGRESS_INTERVAL 1000000000LL
+
+typedef struct {
+
+	/// Files saved against the DB by the previous run
+	size_t estimated_files;
+
+	/// Total size of files saved against the DB by the previous run
+	size_t estimated_size_in_bytes;
+
+	/// When the walk has been started, ns
+	long long int start;
+
+	/// When the progress has been shown last time, ns
+	long long int shown;
+
+} Progress;
+
+static Progress progress;
+
+/**
+ *
+ * Estimate the totals from the previous run
+ * and remember when the walk has been started
+ *
+ */
+Return progress_init(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	memset(&progress,0,sizeof(Progress));
+
+	// Don't do anything
+	if(config->progress == false || config->compare == true)
+	{
+		return(status);
+	}
+
+	if(SUCCESS != (status = db_estimate_totals(&progress.estimated_files,&progress.estimated_size_in_bytes)))
+	{
+		return(status);
+	}
+
+	progress.start = cur_time_ns();
+	progress.shown = progress.start;
+
+	if(progress.estimated_files > 0)
+	{
+		slog(false,"estimated from the previous run: total size: %s, files: %zu\n",bkbmbgbtbpbeb(progress.estimated_size_in_bytes),progress.estimated_files);
+	} else {
+		slog(false,"There is no previous run to estimate the progress from\n");
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Show how many files have been walked through
+ * already and how much time is left approximately
+ *
+ */
+void progress_update
+(
+	size_t files,
+	size_t size_in_bytes
+){
+	if(config->progress == false)
+	{
+		return;
+	}
+
+	long long int now = cur_time_ns();
+
+	if(now - progress.shown < PROGRESS_INTERVAL)
+	{
+		return;
+	}
+
+	progress.shown = now;
+
+	// Functions of the rational library return static buffers
+	char size[MAX_NUMBER_CHARACTERS];
+	snprintf(size,sizeof(size),"%s",bkbmbgbtbpbeb(size_in_bytes));
+
+	if(progress.estimated_files == 0)
+	{
+		slog(false,"progress: %s, files: %zu\n",size,files);
+		return;
+	}
+
+	char estimated_size[MAX_NUMBER_CHARACTERS];
+	snprintf(estimated_size,sizeof(estimated_size),"%s",bkbmbgbtbpbeb(progress.estimated_size_in_bytes));
+
+	// Files of the biggest size take the most of time
+	double done = progress.estimated_size_in_bytes > 0
+		? (double)size_in_bytes / (double)progress.estimated_size_in_bytes
+		: (double)files / (double)progress.estimated_files;
+
+	if(done < 1.0 && done > 0.0)
+	{
+		long long int left = (long long int)((double)(now - progress.start) * (1.0 - done) / done);
+
+		// Whole seconds only
+		left += 1000000000LL - left % 1000000000LL;
+
+		slog(false,"progress: %s of ~%s, files: %zu of ~%zu (%d%%), time left: ~%s\n",size,estimated_size,files,progress.estimated_files,(int)(done * 100.0),form_date(left));
+	} else {
+		slog(false,"progress: %s of ~%s, files: %zu of ~%zu, beyond the estimate\n",size,estimated_size,files,progress.estimated_files);
+	}
+}
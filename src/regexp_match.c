@@ -5,88 +5,400 @@
 
 /**
  *
- * Checks whether PCRE2 regular expression matches a comparison string or not
+ * @file regexp_match.c
+ * @brief PCRE2 regular expressions of --ignore and --include
+ * @details Patterns are compiled and JIT-compiled only once at
+ * start. If it doesn't change the meaning, all patterns of an
+ * option are merged into the single alternation, so a path is
+ * matched only once against all of them. Match data is allocated
+ * once for every thread that matches paths.
  *
  */
-REGEXP regexp_match
+
+struct Regexp {
+
+	/// Every pattern compiled on its own
+	pcre2_code **codes;
+
+	/// Number of patterns
+	size_t count;
+
+	/// All patterns as one alternation. NULL
+	/// if the patterns could not be merged
+	pcre2_code *merged;
+
+	/// Source patterns to show in messages
+	char **patterns;
+
+};
+
+// Match data of the current thread. Only one match is
+// needed to decide, so it is never bigger than that
+static _Thread_local pcre2_match_data *match_data = NULL;
+
+/**
+ *
+ * Match data of the current thread. Created on the first use
+ *
+ */
+static pcre2_match_data *thread_match_data(void)
+{
+	if(match_data == NULL)
+	{
+		match_data = pcre2_match_data_create(1,NULL);
+
+		if(match_data == NULL)
+		{
+			slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+		}
+	}
+
+	return(match_data);
+}
+
+/**
+ *
+ * True if the pattern could be a part of an alternation with
+ * other patterns without changing the meaning. Capture groups
+ * would be renumbered, while recursions of the whole pattern
+ * and backtracking verbs would affect other alternatives
+ *
+ */
+static bool could_be_merged
 (
-	const char *regexp,
-	const char *relative_path,
-	bool *showed_once
+	const char *pattern,
+	const pcre2_code *code
+){
+	uint32_t captures = 0;
+
+	if(0 != pcre2_pattern_info(code,PCRE2_INFO_CAPTURECOUNT,&captures) || captures > 0)
+	{
+		return(false);
+	}
+
+	if(strstr(pattern,"(*") != NULL
+		|| strstr(pattern,"(?R") != NULL
+		|| strstr(pattern,"(?0") != NULL
+		|| strstr(pattern,"\\g") != NULL)
+	{
+		return(false);
+	}
+
+	return(true);
+}
+
+/**
+ *
+ * Compile the string array of PCRE2 regular expressions.
+ * Nothing is allocated if the array is NULL
+ *
+ */
+Return regexp_compile
+(
+	char **patterns,
+	Regexp **regexp
 ){
-	bool match = false;
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
 
-	/* for pcre2_compile */
-	pcre2_code *re;
-	PCRE2_SIZE erroffset;
-	int errcode;
-	PCRE2_UCHAR8 buffer[127];
+	*regexp = NULL;
 
-	/* for pcre2_match */
-	int rc;
-#if 0
-	PCRE2_SIZE* ovector;
-#endif
+	if(patterns == NULL || patterns[0] == NULL)
+	{
+		return(status);
+	}
+
+	Regexp *re = (Regexp *)calloc(1,sizeof(Regexp));
+	if(re == NULL)
+	{
+		slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+		status = FAILURE;
+		return(status);
+	}
+
+	*regexp = re;
+	re->patterns = patterns;
 
-	const unsigned char *pattern = (const unsigned char*)regexp;
-	size_t pattern_size = strlen(regexp);
+	while(patterns[re->count] != NULL)
+	{
+		re->count++;
+	}
+
+	re->codes = (pcre2_code **)calloc(re->count,sizeof(pcre2_code *));
+	if(re->codes == NULL)
+	{
+		slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+		status = FAILURE;
+		return(status);
+	}
 
-	const unsigned char *subject = (const unsigned char*)relative_path;
-	size_t subject_size = strlen(relative_path);
-	uint32_t options = 0;
+	bool mergeable = re->count > 1;
 
-	pcre2_match_data *match_data;
-	uint32_t ovecsize = 128;
+	// (?:pattern)| for every pattern
+	size_t merged_size = 0;
 
-	re = pcre2_compile(pattern, pattern_size, options, &errcode, &erroffset, NULL);
-	if (re == NULL)
+	for(size_t i = 0; i < re->count; i++)
 	{
-		if(*showed_once == false)
+		PCRE2_SIZE erroffset;
+		int errcode;
+		PCRE2_UCHAR8 buffer[127];
+
+		re->codes[i] = pcre2_compile((PCRE2_SPTR)patterns[i],PCRE2_ZERO_TERMINATED,0,&errcode,&erroffset,NULL);
+		if(re->codes[i] == NULL)
 		{
-			*showed_once = true;
 			pcre2_get_error_message(errcode, buffer, 127);
-			slog(false,"PCRE2 regular expression %s has an error:%d %s\n",pattern,errcode,buffer);
+			slog(false,"PCRE2 regular expression %s has an error:%d %s\n",patterns[i],errcode,buffer);
+			status = FAILURE;
+			return(status);
 		}
-		return(REGEXP_ERROR);
+
+		// The interpreter is still there if JIT is not available.
+		// Partial matching is used for whole directories
+		pcre2_jit_compile(re->codes[i],PCRE2_JIT_COMPLETE | PCRE2_JIT_PARTIAL_HARD);
+
+		if(mergeable == true)
+		{
+			mergeable = could_be_merged(patterns[i],re->codes[i]);
+		}
+
+		merged_size += strlen(patterns[i]) + 5;
 	}
 
-	match_data = pcre2_match_data_create(ovecsize, NULL);
-	rc = pcre2_match(re, subject, subject_size, 0, options, match_data, NULL);
-	if(rc == 0)
+	if(mergeable == true)
 	{
-		if(*showed_once == false)
+		char *merged = (char *)calloc(merged_size + 1,sizeof(char));
+		if(merged == NULL)
 		{
-			*showed_once = true;
-			pcre2_get_error_message(errcode, buffer, 127);
-			slog(false,"PCRE2 regular expression %s has an error: %d \"offset vector too small\"\n",pattern,rc);
+			slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+			status = FAILURE;
+			return(status);
+		}
+
+		for(size_t i = 0; i < re->count; i++)
+		{
+			if(i > 0)
+			{
+				strcat(merged,"|");
+			}
+			strcat(merged,"(?:");
+			strcat(merged,patterns[i]);
+			strcat(merged,")");
+		}
+
+		PCRE2_SIZE erroffset;
+		int errcode;
+
+		// Comments or \Q without \E could swallow the rest of the
+		// alternation. Then the patterns are just matched one by one
+		re->merged = pcre2_compile((PCRE2_SPTR)merged,PCRE2_ZERO_TERMINATED,0,&errcode,&erroffset,NULL);
+
+		if(re->merged != NULL)
+		{
+			pcre2_jit_compile(re->merged,PCRE2_JIT_COMPLETE | PCRE2_JIT_PARTIAL_HARD);
 		}
+
+		free(merged);
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Compile regular expressions of --ignore and --include
+ * once for all paths that will be checked against them
+ *
+ */
+Return regexp_init(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	if(SUCCESS == (status = regexp_compile(config->ignore,&config->ignore_regexp)))
+	{
+		status = regexp_compile(config->include,&config->include_regexp);
+	}
+
+	if(SUCCESS == status && (config->ignore != NULL || config->include != NULL))
+	{
+		uint32_t jit = 0;
+
+		pcre2_config(PCRE2_CONFIG_JIT,&jit);
+
+		slog(true,"PCRE2 regular expressions have been compiled%s\n",jit == 1 ? " with JIT" : "");
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Checks whether PCRE2 regular expressions match a comparison string or not
+ *
+ */
+REGEXP regexp_match
+(
+	const Regexp *regexp,
+	const char *relative_path,
+	bool *showed_once
+){
+	if(thread_match_data() == NULL)
+	{
 		return(REGEXP_ERROR);
 	}
-	else if(rc > 0)
+
+	if(regexp->merged != NULL)
+	{
+		int rc = pcre2_match(regexp->merged,(PCRE2_SPTR)relative_path,PCRE2_ZERO_TERMINATED,0,0,match_data,NULL);
+
+		if(rc >= 0)
+		{
+			return(MATCH);
+
+		} else if(rc == PCRE2_ERROR_NOMATCH)
+		{
+			return(NOT_MATCH);
+		}
+
+		// Find out which pattern exactly fails
+	}
+
+	for(size_t i = 0; i < regexp->count; i++)
+	{
+		// 0 means that the ovector is too small to keep all
+		// captured substrings. The path matches anyway
+		int rc = pcre2_match(regexp->codes[i],(PCRE2_SPTR)relative_path,PCRE2_ZERO_TERMINATED,0,0,match_data,NULL);
+
+		if(rc >= 0)
+		{
+			return(MATCH);
+
+		} else if(rc != PCRE2_ERROR_NOMATCH)
+		{
+			if(*showed_once == false)
+			{
+				PCRE2_UCHAR8 buffer[127];
+
+				*showed_once = true;
+				pcre2_get_error_message(rc, buffer, 127);
+				slog(false,"PCRE2 regular expression %s has an error: %d %s\n",regexp->patterns[i],rc,buffer);
+			}
+			return(REGEXP_ERROR);
+		}
+	}
+
+	return(NOT_MATCH);
+}
+
+/**
+ *
+ * True if the regular expressions match every path that starts
+ * with the directory path. The path of the directory should end
+ * with a slash. With PCRE2_PARTIAL_HARD a match that has ever
+ * reached the end of the subject is reported as a partial one, so
+ * a complete match doesn't depend on anything that could follow
+ * the directory path. Errors are reported as no match
+ *
+ */
+bool regexp_match_every_path_in
+(
+	const Regexp *regexp,
+	const char *directory
+){
+	if(thread_match_data() == NULL)
+	{
+		return(false);
+	}
+
+	const pcre2_code *merged = regexp->merged;
+	size_t count = merged != NULL ? 1 : regexp->count;
+
+	for(size_t i = 0; i < count; i++)
+	{
+		const pcre2_code *code = merged != NULL ? merged : regexp->codes[i];
+
+		if(pcre2_match(code,(PCRE2_SPTR)directory,PCRE2_ZERO_TERMINATED,0,PCRE2_PARTIAL_HARD,match_data,NULL) >= 0)
+		{
+			return(true);
+		}
+	}
+
+	return(false);
+}
+
+/**
+ *
+ * True if the regular expressions could match any path that
+ * starts with the directory path. The path of the directory
+ * should end with a slash. A pattern that is not anchored to the
+ * beginning could match anything deeper. Errors are reported as
+ * a possible match
+ *
+ */
+bool regexp_could_match_any_path_in
+(
+	const Regexp *regexp,
+	const char *directory
+){
+	if(thread_match_data() == NULL)
+	{
+		return(true);
+	}
+
+	for(size_t i = 0; i < regexp->count; i++)
 	{
-#if 0
-		ovector = pcre2_get_ovector_pointer(match_data);
-#endif
+		uint32_t options = 0;
 
-		for(PCRE2_SIZE i = 0; i < (size_t)rc; i++)
+		if(0 != pcre2_pattern_info(regexp->codes[i],PCRE2_INFO_ALLOPTIONS,&options)
+			|| (options & PCRE2_ANCHORED) == 0)
 		{
-#if 0
-			PCRE2_SPTR start = subject + ovector[2*i];
-			PCRE2_SIZE slen = ovector[2*i+1] - ovector[2*i];
-			printf( "%2ld: %.*s\n", i, (int)slen, (const char *)start );
-#endif
-			match = true;
+			return(true);
+		}
+
+		int rc = pcre2_match(regexp->codes[i],(PCRE2_SPTR)directory,PCRE2_ZERO_TERMINATED,0,PCRE2_PARTIAL_HARD,match_data,NULL);
+
+		if(rc != PCRE2_ERROR_NOMATCH)
+		{
+			return(true);
 		}
 	}
-#if 0
-	else if (rc < 0)
+
+	return(false);
+}
+
+/**
+ *
+ * Release compiled regular expressions and the
+ * match data of the current thread
+ *
+ */
+void regexp_free
+(
+	Regexp *regexp
+){
+	if(match_data != NULL)
+	{
+		pcre2_match_data_free(match_data);
+		match_data = NULL;
+	}
+
+	if(regexp == NULL)
 	{
-		printf("No match\n");
+		return;
+	}
+
+	if(regexp->codes != NULL)
+	{
+		for(size_t i = 0; i < regexp->count; i++)
+		{
+			pcre2_code_free(regexp->codes[i]);
+		}
+		free(regexp->codes);
 	}
-#endif
 
-	pcre2_match_data_free(match_data);
-	pcre2_code_free(re);
+	pcre2_code_free(regexp->merged);
 
-	return(match);
+	free(regexp);
 }
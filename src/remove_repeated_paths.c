@@ -0,0 +1,122 @@
+#include "precizer.h"
+#include <errno.h>
+
+/**
+ *
+ * Check up whether the directory with the resolved path
+ * inside lies within the directory with the resolved
+ * path outside
+ *
+ */
+static bool is_inside
+(
+	const char *inside,
+	const char *outside
+){
+	size_t length = strlen(outside);
+
+	if(strcmp(outside,"/") == 0)
+	{
+		return(true);
+	}
+
+	return(strncmp(inside,outside,length) == 0 && inside[length] == '/');
+}
+
+/**
+ *
+ * Every file should be found under only one of paths passed as
+ * arguments, otherwise it is saved twice, once under each path.
+ * A path that leads to the same directory as one of the previous
+ * paths, like "dir" and "./dir/" or a symlink to it, is traversed
+ * only once. Paths inside of each other can't be traversed together
+ *
+ */
+Return remove_repeated_paths(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	// Don't do anything
+	if(config->compare == true)
+	{
+		return(status);
+	}
+
+	size_t count = 0;
+
+	while(config->paths[count] != NULL)
+	{
+		count++;
+	}
+
+	// Resolved paths of directories that will be traversed
+	char **resolved = (char **)calloc(count + 1,sizeof(char *));
+	if(resolved == NULL)
+	{
+		slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+		status = FAILURE;
+		return(status);
+	}
+
+	size_t kept = 0;
+
+	for(size_t i = 0; SUCCESS == status && i < count; i++)
+	{
+		char *path = realpath(config->paths[i],NULL);
+		if(path == NULL)
+		{
+			slog(false,"Can't resolve the path %s: %s\n",config->paths[i],strerror(errno));
+			status = FAILURE;
+			break;
+		}
+
+		bool repeated = false;
+
+		for(size_t j = 0; j < kept; j++)
+		{
+			if(strcmp(path,resolved[j]) == 0)
+			{
+				// The same files would be found and written twice
+				if(strcmp(config->paths[i],config->paths[j]) == 0)
+				{
+					slog(false,"The path %s has been passed more than once and will be traversed only once\n",config->paths[i]);
+				} else {
+					slog(false,"The path %s leads to the same directory as %s and will be traversed only once\n",config->paths[i],config->paths[j]);
+				}
+				repeated = true;
+				break;
+			}
+
+			if(is_inside(path,resolved[j]) == true || is_inside(resolved[j],path) == true)
+			{
+				slog(false,"ERROR: The paths %s and %s are inside of each other, so the same files would be saved twice. Pass only one of them\n",config->paths[j],config->paths[i]);
+				status = FAILURE;
+				break;
+			}
+		}
+
+		if(repeated == true || SUCCESS != status)
+		{
+			free(path);
+		} else {
+			resolved[kept] = path;
+			config->paths[kept] = config->paths[i];
+			kept++;
+		}
+	}
+
+	if(SUCCESS == status)
+	{
+		config->paths[kept] = NULL;
+	}
+
+	for(size_t i = 0; i < kept; i++)
+	{
+		free(resolved[i]);
+	}
+	free(resolved);
+
+	return(status);
+}
@@ -48,6 +48,7 @@ void show_relative_path
 	const char *relative_path,
 	const int *metadata_of_scanned_and_saved_files,
 	const DBrow *dbrow,
+	const HashAlgorithm *algorithm,
 	const struct stat *fts_statp,
 	bool *first_iteration,
 	bool *show_changes,
@@ -89,11 +90,17 @@ void show_relative_path
 		{
 			if(*rehashig_from_the_beginning)
 			{
-				printf(" the SHA512 hashing of the file had not been finished previously, since then the file has been changed and will be rehashed from the beginning\n");
+				printf(" the hashing of the file had not been finished previously, since then the file has been changed or another hash algorithm has been chosen, so it will be rehashed from the beginning\n");
 			} else {
 				if(*show_changes == true)
 				{
-					if(*metadata_of_scanned_and_saved_files != IDENTICAL
+					if(*metadata_of_scanned_and_saved_files == IDENTICAL
+						&& dbrow->relative_path_already_in_db == true
+						&& dbrow->saved_algorithm != *algorithm)
+					{
+						printf(" rehashing with %s instead of %s",hash_algorithm_name(*algorithm),hash_algorithm_name(dbrow->saved_algorithm));
+
+					} else if(*metadata_of_scanned_and_saved_files != IDENTICAL
 						&& dbrow->relative_path_already_in_db == true)
 					{
 						printf(" changed ");
@@ -0,0 +1,985 @@
+#include "precizer.h"
+#include <fts.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdatomic.h>
+#if defined(__linux__) && !defined(__COSMOPOLITAN__)
+#include <sys/syscall.h>
+#endif
+
+#ifdef SYS_getdents64
+// Records of the kernel are read right into the buffer
+typedef struct dirent64 DirectoryRecord;
+#else
+// One record per readdir()
+typedef struct dirent DirectoryRecord;
+#endif
+
+/**
+ *
+ * @file traversal.c
+ * @brief Traversal of the file hierarchy
+ * @details By default the hierarchy is walked by fts with one thread
+ * in the same order as always. With --traversal-threads directories
+ * are read by a pool of readers in parallel. A reader takes a
+ * directory, lists it with getdents64() and fstatat() relative to
+ * the descriptor of the directory, passes subdirectories back to
+ * the pool and hands all entries of the directory over to the only
+ * thread that owns the database. On network file systems the walk
+ * is bound by the latency of every call, so many directories are
+ * read at once. Entries of one directory come out together, while
+ * directories come out in no particular order.
+ *
+ */
+
+// Stack size of a reader
+#define READER_STACK_SIZE (1024 * 1024)
+
+// Entries handed over to the consumer at once
+#define ENTRIES_PER_BATCH 1024
+
+// Batches that could wait for the consumer for each reader
+#define BATCHES_PER_READER 4
+
+// Size of the buffer for getdents64()
+#define DIRENT_BUFFER_SIZE (32 * 1024)
+
+/* An open directory. It is shared by its subdirectories waiting
+ * to be read and by its entries waiting to be processed, so files
+ * are opened relative to it by their short names */
+typedef struct {
+
+	/// Descriptor of the directory
+	int fd;
+
+	/// Users of the descriptor
+	_Atomic unsigned int references;
+
+} Directory;
+
+/* A directory waiting to be read */
+typedef struct DirectoryTask {
+
+	/// The parent directory. NULL for paths passed as arguments
+	Directory *parent;
+
+	/// Path starting with the path passed as an argument
+	char *path;
+
+	/// Name of the directory within the parent
+	const char *name;
+
+	/// Index of the path passed as an argument
+	size_t root;
+
+	/// Depth of the directory. Paths passed as arguments are 0
+	short level;
+
+	/// Next directory in the stack
+	struct DirectoryTask *next;
+
+} DirectoryTask;
+
+/* Entries of one directory handed over at once */
+typedef struct Batch {
+
+	/// The directory entries could be opened from
+	Directory *directory;
+
+	/// Entries of the directory
+	TraversalEntry *entries;
+
+	/// Number of entries
+	size_t count;
+
+	/// Next batch in the queue
+	struct Batch *next;
+
+} Batch;
+
+typedef struct {
+
+	/* The walk by fts */
+
+	/// fts handle
+	FTS *file_systems;
+
+	/// The next path passed as an argument
+	FTSENT *current_file_system;
+
+	/// Absolute path prefix of the current path passed as an argument
+	char *runtime_path_prefix;
+
+	/// Paths passed as arguments the walk has reached so far
+	size_t roots;
+
+	/// The entry returned last time
+	TraversalEntry entry;
+
+	/* The walk by readers */
+
+	/// Protects all fields below
+	pthread_mutex_t mutex;
+
+	/// Signals that a directory has been added to the stack
+	pthread_cond_t task_added;
+
+	/// Signals that a batch has been added to the queue
+	/// or the walk has been finished
+	pthread_cond_t batch_added;
+
+	/// Signals that a batch has been taken from the queue
+	pthread_cond_t batch_taken;
+
+	/// Stack of directories waiting to be read. Depth-first
+	/// order keeps the number of open directories small
+	DirectoryTask *tasks;
+
+	/// Directories being read right now
+	size_t busy;
+
+	/// Queue of batches waiting for the consumer
+	Batch *batches_head;
+	Batch *batches_tail;
+
+	/// Batches in the queue
+	size_t batches;
+
+	/// Upper limit of batches in the queue. Bounds memory usage
+	size_t capacity;
+
+	/// The consumer doesn't need anything more
+	bool shutdown;
+
+	/// Paths passed as arguments without trailing slashes
+	char **prefixes;
+
+	/// Devices of paths passed as arguments
+	dev_t *devices;
+
+	/// Reader threads
+	pthread_t *readers;
+
+	/// Number of started readers
+	unsigned short count;
+
+	/// The batch being processed by the consumer
+	Batch *current;
+
+	/// The next entry of the current batch
+	size_t position;
+
+} Traversal;
+
+static Traversal traversal;
+
+/**
+ *
+ * Release one user of an open directory
+ *
+ */
+static void directory_release
+(
+	Directory *directory
+){
+	if(directory != NULL && atomic_fetch_sub(&directory->references,1) == 1)
+	{
+		close(directory->fd);
+		free(directory);
+	}
+}
+
+/**
+ *
+ * Release a batch of entries and its directory
+ *
+ */
+static void batch_free
+(
+	Batch *batch
+){
+	if(batch == NULL)
+	{
+		return;
+	}
+
+	for(size_t i = 0; i < batch->count; i++)
+	{
+		free(batch->entries[i].path);
+	}
+
+	free(batch->entries);
+	directory_release(batch->directory);
+	free(batch);
+}
+
+/**
+ *
+ * A new empty batch for entries of the directory
+ *
+ */
+static Batch *batch_new
+(
+	Directory *directory
+){
+	Batch *batch = (Batch *)calloc(1,sizeof(Batch));
+
+	if(batch != NULL)
+	{
+		batch->entries = (TraversalEntry *)calloc(ENTRIES_PER_BATCH,sizeof(TraversalEntry));
+
+		if(batch->entries == NULL)
+		{
+			free(batch);
+			return(NULL);
+		}
+
+		if(directory != NULL)
+		{
+			atomic_fetch_add(&directory->references,1);
+		}
+		batch->directory = directory;
+	}
+
+	return(batch);
+}
+
+/**
+ *
+ * Hand a batch over to the consumer. Wait while the
+ * queue is full. Empty batches are just released
+ *
+ */
+static void batch_hand_over
+(
+	Batch *batch
+){
+	if(batch->count == 0)
+	{
+		batch_free(batch);
+		return;
+	}
+
+	pthread_mutex_lock(&traversal.mutex);
+
+	while(traversal.batches >= traversal.capacity && traversal.shutdown == false)
+	{
+		pthread_cond_wait(&traversal.batch_taken,&traversal.mutex);
+	}
+
+	if(traversal.shutdown == true)
+	{
+		pthread_mutex_unlock(&traversal.mutex);
+		batch_free(batch);
+		return;
+	}
+
+	if(traversal.batches_tail == NULL)
+	{
+		traversal.batches_head = batch;
+	} else {
+		traversal.batches_tail->next = batch;
+	}
+	traversal.batches_tail = batch;
+	traversal.batches++;
+
+	pthread_cond_signal(&traversal.batch_added);
+	pthread_mutex_unlock(&traversal.mutex);
+}
+
+/**
+ *
+ * Put a directory on the stack of directories to be read
+ *
+ */
+static void task_push
+(
+	DirectoryTask *task
+){
+	pthread_mutex_lock(&traversal.mutex);
+	task->next = traversal.tasks;
+	traversal.tasks = task;
+	pthread_cond_signal(&traversal.task_added);
+	pthread_mutex_unlock(&traversal.mutex);
+}
+
+/**
+ *
+ * Release a directory task and its parent
+ *
+ */
+static void task_free
+(
+	DirectoryTask *task
+){
+	directory_release(task->parent);
+	free(task->path);
+	free(task);
+}
+
+/**
+ *
+ * Read the next portion of names from the directory.
+ * Returns the number of bytes read into the buffer,
+ * 0 at the end of the directory or -1 on error
+ *
+ */
+static long read_names
+(
+	int fd,
+	DIR **dir,
+	char *buffer
+){
+#ifdef SYS_getdents64
+	(void)dir;
+
+	long len;
+
+	while((len = syscall(SYS_getdents64,fd,buffer,DIRENT_BUFFER_SIZE)) < 0 && errno == EINTR);
+
+	return(len);
+#else
+	/* Portable way: one name per call */
+	if(*dir == NULL)
+	{
+		int copy = dup(fd);
+
+		if(copy < 0 || (*dir = fdopendir(copy)) == NULL)
+		{
+			if(copy >= 0)
+			{
+				close(copy);
+			}
+			return(-1);
+		}
+	}
+
+	struct dirent *dirent = readdir(*dir);
+
+	if(dirent == NULL)
+	{
+		return(0);
+	}
+
+	size_t size = offsetof(DirectoryRecord,d_name) + strlen(dirent->d_name) + 1;
+
+	// Keep records aligned
+	size = (size + 7) & ~(size_t)7;
+
+	memcpy(buffer,dirent,size < sizeof(DirectoryRecord) ? size : sizeof(DirectoryRecord));
+	((DirectoryRecord *)buffer)->d_reclen = (unsigned short)size;
+
+	return((long)size);
+#endif
+}
+
+/**
+ *
+ * Read one directory. Every entry is passed to the consumer,
+ * subdirectories that should be traversed are passed to
+ * other readers
+ *
+ */
+static void read_directory
+(
+	DirectoryTask *task
+){
+	struct stat stat;
+
+	const char *prefix = traversal.prefixes[task->root];
+	const size_t prefix_size = strlen(prefix);
+
+	int fd = -1;
+
+	if(task->parent == NULL)
+	{
+		/* The path passed as an argument is an entry by itself */
+		Batch *batch = batch_new(NULL);
+
+		if(batch == NULL || lstat(config->paths[task->root],&stat) != 0)
+		{
+			batch_free(batch);
+			return;
+		}
+
+		TraversalEntry *entry = &batch->entries[batch->count++];
+
+		entry->path = strdup(prefix);
+		if(entry->path == NULL)
+		{
+			batch->count--;
+			batch_free(batch);
+			return;
+		}
+		entry->relative_path = entry->path + prefix_size;
+		entry->dirfd = AT_FDCWD;
+		entry->name = config->paths[task->root];
+		entry->level = 0;
+		entry->root = task->root;
+		memcpy(&entry->stat,&stat,sizeof(struct stat));
+		entry->type = S_ISDIR(stat.st_mode) ? ENTRY_DIRECTORY : S_ISLNK(stat.st_mode) ? ENTRY_SYMLINK : S_ISREG(stat.st_mode) ? ENTRY_FILE : ENTRY_OTHER;
+
+		traversal.devices[task->root] = stat.st_dev;
+
+		batch_hand_over(batch);
+
+		if(!S_ISDIR(stat.st_mode))
+		{
+			return;
+		}
+
+		fd = open(config->paths[task->root],O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	} else {
+
+		while((fd = openat(task->parent->fd,task->name,O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)) < 0 && errno == EINTR);
+	}
+
+	if(fd < 0)
+	{
+		// Like FTS_DNR, the directory is just not traversed
+		return;
+	}
+
+	Directory *directory = (Directory *)malloc(sizeof(Directory));
+	if(directory == NULL)
+	{
+		close(fd);
+		return;
+	}
+	directory->fd = fd;
+	atomic_init(&directory->references,1);
+
+	Batch *batch = batch_new(directory);
+
+	// Paths of entries are "path/name"
+	const size_t path_size = strlen(task->path);
+
+	char buffer[DIRENT_BUFFER_SIZE] __attribute__ ((aligned (8)));
+	DIR *dir = NULL;
+	long len = 0;
+
+	while(batch != NULL && global_interrupt_flag == false && (len = read_names(fd,&dir,buffer)) > 0)
+	{
+		for(long position = 0; position < len && batch != NULL;)
+		{
+			const DirectoryRecord *dirent = (const DirectoryRecord *)(buffer + position);
+			position += dirent->d_reclen;
+
+			const char *name = dirent->d_name;
+
+			if(name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+			{
+				continue;
+			}
+
+			if(fstatat(fd,name,&stat,AT_SYMLINK_NOFOLLOW) != 0)
+			{
+				// Like FTS_NS, removed since listed or not accessible
+				continue;
+			}
+
+			const size_t name_size = strlen(name);
+
+			char *path = (char *)malloc(path_size + 1 + name_size + 1);
+			if(path == NULL)
+			{
+				continue;
+			}
+			memcpy(path,task->path,path_size);
+			path[path_size] = '/';
+			memcpy(path + path_size + 1,name,name_size + 1);
+
+			TraversalEntry *entry = &batch->entries[batch->count++];
+
+			entry->path = path;
+			entry->relative_path = path + prefix_size + 1 + correction(path + prefix_size + 1);
+			entry->dirfd = fd;
+			entry->name = path + path_size + 1;
+			entry->level = (short)(task->level + 1);
+			entry->root = task->root;
+			memcpy(&entry->stat,&stat,sizeof(struct stat));
+			entry->ignored = false;
+
+			if(S_ISREG(stat.st_mode))
+			{
+				entry->type = ENTRY_FILE;
+
+			} else if(S_ISLNK(stat.st_mode))
+			{
+				entry->type = ENTRY_SYMLINK;
+
+			} else if(S_ISDIR(stat.st_mode))
+			{
+				entry->type = ENTRY_DIRECTORY;
+
+				// Files deeper than --maxdepth are never used,
+				// other file systems are not traversed (FTS_XDEV)
+				bool descend = (config->maxdepth < 0 || entry->level <= config->maxdepth)
+					&& stat.st_dev == traversal.devices[task->root];
+
+				if(descend == true && ignore_directory(entry->relative_path) == true)
+				{
+					entry->ignored = true;
+					descend = false;
+				}
+
+				if(descend == true)
+				{
+					DirectoryTask *subdirectory = (DirectoryTask *)calloc(1,sizeof(DirectoryTask));
+
+					if(subdirectory != NULL && (subdirectory->path = strdup(path)) != NULL)
+					{
+						atomic_fetch_add(&directory->references,1);
+						subdirectory->parent = directory;
+						subdirectory->name = subdirectory->path + path_size + 1;
+						subdirectory->root = task->root;
+						subdirectory->level = entry->level;
+						task_push(subdirectory);
+					} else {
+						free(subdirectory);
+					}
+				}
+
+			} else {
+
+				entry->type = ENTRY_OTHER;
+			}
+
+			if(batch->count == ENTRIES_PER_BATCH)
+			{
+				batch_hand_over(batch);
+				batch = batch_new(directory);
+			}
+		}
+	}
+
+	if(dir != NULL)
+	{
+		closedir(dir);
+	}
+
+	if(batch != NULL)
+	{
+		batch_hand_over(batch);
+	}
+
+	directory_release(directory);
+}
+
+/**
+ *
+ * Reader loop. Take a directory from the stack and read it
+ * until there is nothing left to read and nobody is reading
+ *
+ */
+static void *traversal_reader(void *arg)
+{
+	(void)arg;
+
+	while(true)
+	{
+		pthread_mutex_lock(&traversal.mutex);
+
+		while(traversal.tasks == NULL && traversal.busy > 0 && traversal.shutdown == false)
+		{
+			pthread_cond_wait(&traversal.task_added,&traversal.mutex);
+		}
+
+		DirectoryTask *task = traversal.tasks;
+
+		if(task == NULL || traversal.shutdown == true)
+		{
+			// Wake up other readers and the consumer. The walk is over
+			pthread_cond_broadcast(&traversal.task_added);
+			pthread_cond_broadcast(&traversal.batch_added);
+			pthread_mutex_unlock(&traversal.mutex);
+			break;
+		}
+
+		traversal.tasks = task->next;
+		traversal.busy++;
+
+		pthread_mutex_unlock(&traversal.mutex);
+
+		read_directory(task);
+
+		task_free(task);
+
+		pthread_mutex_lock(&traversal.mutex);
+
+		traversal.busy--;
+
+		if(traversal.busy == 0 && traversal.tasks == NULL)
+		{
+			pthread_cond_broadcast(&traversal.task_added);
+		}
+
+		// The consumer should notice Ctrl+C as well
+		if(traversal.busy == 0 || global_interrupt_flag == true)
+		{
+			pthread_cond_broadcast(&traversal.batch_added);
+		}
+
+		pthread_mutex_unlock(&traversal.mutex);
+	}
+
+	// Match data of regular expressions of this thread
+	regexp_free(NULL);
+
+	return(NULL);
+}
+
+/**
+ *
+ * Start the traversal of all paths passed as arguments
+ *
+ */
+Return traversal_init(void)
+{
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	memset(&traversal,0,sizeof(Traversal));
+
+	if(config->traversal_threads == 0)
+	{
+		int fts_options = FTS_PHYSICAL | FTS_XDEV;
+
+		// fts switches into every directory it visits, so files are
+		// opened right there by their short names
+		if((traversal.file_systems = fts_open(config->paths, fts_options, NULL)) == NULL)
+		{
+			slog(false,"fts_open() error\n");
+			status = FAILURE;
+			return(status);
+		}
+
+		/* Initialize file_systems with as many argv[] parts as possible. */
+		traversal.current_file_system = fts_children(traversal.file_systems, 0);
+
+		return(status);
+	}
+
+	size_t roots = 0;
+
+	while(config->paths[roots] != NULL)
+	{
+		roots++;
+	}
+
+	traversal.prefixes = (char **)calloc(roots,sizeof(char *));
+	traversal.devices = (dev_t *)calloc(roots,sizeof(dev_t));
+	traversal.readers = (pthread_t *)calloc(config->traversal_threads,sizeof(pthread_t));
+
+	if(traversal.prefixes == NULL || traversal.devices == NULL || traversal.readers == NULL)
+	{
+		slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+		status = FAILURE;
+		return(status);
+	}
+
+	pthread_mutex_init(&traversal.mutex,NULL);
+	pthread_cond_init(&traversal.task_added,NULL);
+	pthread_cond_init(&traversal.batch_added,NULL);
+	pthread_cond_init(&traversal.batch_taken,NULL);
+
+	traversal.capacity = (size_t)config->traversal_threads * BATCHES_PER_READER;
+
+	/* Paths passed as arguments are read first and in order */
+	for(size_t i = roots; i-- > 0;)
+	{
+		DirectoryTask *task = (DirectoryTask *)calloc(1,sizeof(DirectoryTask));
+
+		if(task == NULL || (traversal.prefixes[i] = strdup(config->paths[i])) == NULL
+			|| (task->path = strdup(config->paths[i])) == NULL)
+		{
+			slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+			free(task);
+			status = FAILURE;
+			return(status);
+		}
+
+		// Remove unnecessary trailing slash at the end of the directory path
+		remove_trailing_slash(traversal.prefixes[i]);
+		remove_trailing_slash(task->path);
+
+		task->root = i;
+		task_push(task);
+	}
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr,READER_STACK_SIZE);
+
+	for(unsigned short i = 0; i < config->traversal_threads; i++)
+	{
+		if(0 != pthread_create(&traversal.readers[i],&attr,traversal_reader,NULL))
+		{
+			slog(false,"Can't start traversal reader %u\n",i);
+			status = FAILURE;
+			break;
+		}
+		traversal.count++;
+	}
+
+	pthread_attr_destroy(&attr);
+
+	if(SUCCESS == status)
+	{
+		slog(true,"Started %u traversal readers\n",traversal.count);
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * The next entry of the walk by fts
+ *
+ */
+static Return fts_next
+(
+	TraversalEntry **next
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	*next = NULL;
+
+	if(traversal.file_systems == NULL)
+	{
+		return(status);
+	}
+
+	FTSENT *p = NULL;
+
+	if((p = fts_read(traversal.file_systems)) == NULL)
+	{
+		return(status);
+	}
+
+	/* Get absolute path prefix from FTSENT structure and current runtime path */
+	if (p == traversal.current_file_system){
+		// All below run once per new path prefix
+		char *tmp = (char *)realloc(traversal.runtime_path_prefix,(p->fts_pathlen + 1) * sizeof(char));
+		if(NULL == tmp)
+		{
+			slog(false,"Realloc error\n");
+			status = FAILURE;
+			return(status);
+		} else {
+			traversal.runtime_path_prefix = tmp;
+		}
+
+		// Remember temporary string in long-lasting variable
+		strcpy(traversal.runtime_path_prefix,p->fts_path);
+
+		// Remove unnecessary trailing slash at the end of the directory path
+		remove_trailing_slash(traversal.runtime_path_prefix);
+
+		// The next
+		traversal.current_file_system = p->fts_link;
+
+		// fts walks paths passed as arguments in their order
+		traversal.roots++;
+	}
+
+	TraversalEntry *entry = &traversal.entry;
+
+	memset(entry,0,sizeof(TraversalEntry));
+
+	switch (p->fts_info) {
+	case FTS_F:
+		entry->type = ENTRY_FILE;
+		break;
+	case FTS_D:
+		entry->type = ENTRY_DIRECTORY;
+		break;
+	case FTS_SL:
+		entry->type = ENTRY_SYMLINK;
+		break;
+	default:
+		entry->type = ENTRY_OTHER;
+		break;
+	}
+
+	entry->path = p->fts_path;
+	entry->dirfd = AT_FDCWD;
+	entry->name = p->fts_accpath;
+	entry->level = p->fts_level;
+	entry->root = traversal.roots > 0 ? traversal.roots - 1 : 0;
+
+	if(p->fts_statp != NULL)
+	{
+		memcpy(&entry->stat,p->fts_statp,sizeof(struct stat));
+	}
+
+	if(p->fts_level == 0 || traversal.runtime_path_prefix == NULL)
+	{
+		entry->relative_path = "";
+	} else {
+		entry->relative_path = p->fts_path + strlen(traversal.runtime_path_prefix) + 1 + correction(p->fts_path + strlen(traversal.runtime_path_prefix) + 1);
+	}
+
+	if(entry->type == ENTRY_DIRECTORY && p->fts_level > 0)
+	{
+		if(config->maxdepth > -1 && p->fts_level > config->maxdepth)
+		{
+			// Files deeper than --maxdepth are never used
+			fts_set(traversal.file_systems,p,FTS_SKIP);
+
+		} else if(ignore_directory(entry->relative_path) == true)
+		{
+			// Don't descend into directories where
+			// every file would be ignored anyway
+			fts_set(traversal.file_systems,p,FTS_SKIP);
+			entry->ignored = true;
+		}
+	}
+
+	*next = entry;
+
+	return(status);
+}
+
+/**
+ *
+ * Take the next entry of the traversal. The entry stays valid
+ * until the next call. NULL means that everything has been
+ * traversed or the traversal has been interrupted
+ *
+ */
+Return traversal_next
+(
+	TraversalEntry **next
+){
+	if(config->traversal_threads == 0)
+	{
+		return(fts_next(next));
+	}
+
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	*next = NULL;
+
+	if(traversal.current != NULL && traversal.position < traversal.current->count)
+	{
+		*next = &traversal.current->entries[traversal.position++];
+		return(status);
+	}
+
+	batch_free(traversal.current);
+	traversal.current = NULL;
+	traversal.position = 0;
+
+	if(traversal.readers == NULL)
+	{
+		return(status);
+	}
+
+	pthread_mutex_lock(&traversal.mutex);
+
+	while(traversal.batches_head == NULL
+		&& (traversal.tasks != NULL || traversal.busy > 0)
+		&& global_interrupt_flag == false)
+	{
+		pthread_cond_wait(&traversal.batch_added,&traversal.mutex);
+	}
+
+	Batch *batch = traversal.batches_head;
+
+	if(batch != NULL)
+	{
+		traversal.batches_head = batch->next;
+		if(traversal.batches_head == NULL)
+		{
+			traversal.batches_tail = NULL;
+		}
+		traversal.batches--;
+
+		pthread_cond_signal(&traversal.batch_taken);
+	}
+
+	pthread_mutex_unlock(&traversal.mutex);
+
+	if(batch != NULL)
+	{
+		traversal.current = batch;
+		*next = &batch->entries[traversal.position++];
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Stop the traversal and release everything
+ *
+ */
+void traversal_free(void)
+{
+	if(traversal.file_systems != NULL)
+	{
+		fts_close(traversal.file_systems);
+	}
+
+	free(traversal.runtime_path_prefix);
+
+	if(traversal.readers != NULL)
+	{
+		pthread_mutex_lock(&traversal.mutex);
+		traversal.shutdown = true;
+		pthread_cond_broadcast(&traversal.task_added);
+		pthread_cond_broadcast(&traversal.batch_taken);
+		pthread_mutex_unlock(&traversal.mutex);
+
+		for(unsigned short i = 0; i < traversal.count; i++)
+		{
+			pthread_join(traversal.readers[i],NULL);
+		}
+
+		batch_free(traversal.current);
+
+		while(traversal.batches_head != NULL)
+		{
+			Batch *next = traversal.batches_head->next;
+			batch_free(traversal.batches_head);
+			traversal.batches_head = next;
+		}
+
+		while(traversal.tasks != NULL)
+		{
+			DirectoryTask *next = traversal.tasks->next;
+			task_free(traversal.tasks);
+			traversal.tasks = next;
+		}
+
+		pthread_cond_destroy(&traversal.batch_taken);
+		pthread_cond_destroy(&traversal.batch_added);
+		pthread_cond_destroy(&traversal.task_added);
+		pthread_mutex_destroy(&traversal.mutex);
+
+		free(traversal.readers);
+	}
+
+	if(traversal.prefixes != NULL)
+	{
+		for(size_t i = 0; config->paths[i] != NULL; i++)
+		{
+			free(traversal.prefixes[i]);
+		}
+		free(traversal.prefixes);
+	}
+
+	free(traversal.devices);
+
+	memset(&traversal,0,sizeof(Traversal));
+}
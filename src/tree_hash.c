@@ -0,0 +1,334 @@
+#include "precizer.h"
+#include <unistd.h>
+#include <errno.h>
+
+/**
+ *
+ * @file tree_hash.c
+ * @brief Hashing of huge files by all workers at once
+ * @details A file is split into chunks of TREE_CHUNK_SIZE bytes.
+ * Every chunk is hashed independently by its own worker and the
+ * checksums of chunks are passed in order through the root hash
+ * of the same algorithm. The checksum of the file is
+ * H(chunk size as 8 bytes big-endian || H(chunk 0) || H(chunk 1) ...)
+ * Finished chunks are saved against the DB as a part of the
+ * hashing state, so an interrupted file is resumed without
+ * rehashing them again.
+ *
+ */
+
+/**
+ *
+ * Hash one chunk of a file. Called by a worker or right
+ * inside tree_hash() if there are no workers at all.
+ * An interrupted chunk is marked as skipped
+ *
+ */
+Return tree_hash_chunk
+(
+	HashJob *chunk
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	if(SUCCESS != (status = hash_init(chunk->algorithm,&chunk->mdContext.plain)))
+	{
+		return(status);
+	}
+
+	const sqlite3_int64 start = chunk->offset;
+
+	status = hashsum(chunk);
+
+	// hashsum() leaves the offset non-zero if interrupted. The
+	// first chunk starts at 0, so after Ctrl+C its offset can't
+	// be trusted and the chunk is just hashed once again next time
+	if(SUCCESS == status && (chunk->offset != 0 || (start == 0 && global_interrupt_flag == true)))
+	{
+		chunk->skipped = true;
+	}
+
+	return(status);
+}
+
+/**
+ *
+ * Take the checksum of a finished chunk into the window
+ * of chunks finished ahead and release the chunk
+ *
+ */
+static Return chunk_done
+(
+	TreeContext *tree,
+	HashJob *chunk
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	if(chunk->skipped == false)
+	{
+		if(SUCCESS == (status = chunk->status))
+		{
+			uint64_t i = chunk->chunk - tree->hashed;
+
+			tree->ahead |= (uint64_t)1 << i;
+			memcpy(tree->ahead_checksums[i],chunk->checksum,MAX_DIGEST_LENGTH);
+		}
+	}
+
+	free_hash_job(chunk);
+
+	return(status);
+}
+
+/**
+ *
+ * Offset of an unfinished file. It only reflects the progress,
+ * the position of every finished chunk is kept in the tree
+ *
+ */
+static sqlite3_int64 tree_progress
+(
+	const HashJob *job
+){
+	const TreeContext *tree = &job->mdContext.tree;
+
+	sqlite3_int64 offset = (sqlite3_int64)(tree->hashed + (uint64_t)__builtin_popcountll(tree->ahead)) * TREE_CHUNK_SIZE;
+
+	if(offset > job->stat.st_size)
+	{
+		offset = job->stat.st_size;
+	}
+
+	return(offset);
+}
+
+/**
+ *
+ * Calculate the checksum of a file as a tree of chunks.
+ * The job could carry the state of previous interrupted
+ * hashing. If the hashing is interrupted again, the job
+ * keeps the state and a non-zero offset. A job without any
+ * progress at all is marked as skipped
+ *
+ */
+Return tree_hash
+(
+	HashJob *job
+){
+	/// The status that will be passed to return() before exiting.
+	/// By default, the function worked without errors.
+	Return status = SUCCESS;
+
+	HashAlgorithm algorithm = hash_plain_of(job->algorithm);
+
+	TreeContext *tree = &job->mdContext.tree;
+
+	const sqlite3_int64 saved_offset = job->offset;
+
+	const uint64_t chunks = (uint64_t)((job->stat.st_size + TREE_CHUNK_SIZE - 1) / TREE_CHUNK_SIZE);
+
+	if(job->offset == 0)
+	{
+		memset(tree,0,sizeof(TreeContext));
+
+		if(SUCCESS != (status = hash_init(algorithm,&tree->root)))
+		{
+			return(status);
+		}
+
+		// The chunk size is a part of the checksum
+		unsigned char header[8];
+
+		for(int i = 0; i < 8; i++)
+		{
+			header[i] = (unsigned char)((uint64_t)TREE_CHUNK_SIZE >> (56 - 8 * i));
+		}
+
+		if(SUCCESS != (status = hash_update(algorithm,&tree->root,header,sizeof(header))))
+		{
+			return(status);
+		}
+	}
+
+	// The next chunk to be hashed
+	uint64_t next = tree->hashed;
+
+	// Chunks passed to workers and not yet collected
+	size_t in_flight = 0;
+
+	bool checkpoints = config->checkpoint_bytes > 0 || config->checkpoint_seconds > 0;
+	Checkpoint checkpoint;
+
+	if(checkpoints == true)
+	{
+		checkpoint_start(&checkpoint,saved_offset);
+	}
+
+	while(SUCCESS == status)
+	{
+		/* Pass the checksums of chunks through the root hash in order */
+		while(tree->hashed < chunks && (tree->ahead & 1) == 1)
+		{
+			if(SUCCESS != (status = hash_update(algorithm,&tree->root,tree->ahead_checksums[0],hash_digest_length(algorithm))))
+			{
+				break;
+			}
+
+			memmove(tree->ahead_checksums[0],tree->ahead_checksums[1],(TREE_WINDOW - 1) * MAX_DIGEST_LENGTH);
+			tree->ahead >>= 1;
+			tree->hashed++;
+		}
+
+		if(SUCCESS != status || tree->hashed == chunks)
+		{
+			break;
+		}
+
+		/* Save finished chunks from time to time, not only on Ctrl+C */
+		if(checkpoints == true)
+		{
+			const sqlite3_int64 progress = tree_progress(job);
+
+			if(checkpoint_is_due(&checkpoint,progress) == true)
+			{
+				db_writer_lock();
+				status = db_save_checkpoint(job,progress,&job->mdContext);
+				db_writer_unlock();
+
+				if(SUCCESS != status)
+				{
+					break;
+				}
+			}
+		}
+
+		if(next < tree->hashed)
+		{
+			next = tree->hashed;
+		}
+
+		/* Start new chunks as long as they fit into the window */
+		while(global_interrupt_flag == false
+			&& next < chunks
+			&& next < tree->hashed + TREE_WINDOW
+			&& (config->threads == 0 || hashing_pool_is_full() == false))
+		{
+			if(((tree->ahead >> (next - tree->hashed)) & 1) == 1)
+			{
+				// Already hashed before the interruption
+				next++;
+				continue;
+			}
+
+			HashJob *chunk = (HashJob *)calloc(1,sizeof(HashJob));
+			if(chunk == NULL || (chunk->path = strdup(job->path)) == NULL)
+			{
+				slog(false,"ERROR: Memory allocation did not complete successfully!\n");
+				if(chunk != NULL)
+				{
+					chunk->fd = -1;
+				}
+				free_hash_job(chunk);
+				status = FAILURE;
+				break;
+			}
+
+			// Every chunk owns its descriptor and closes it with itself
+			if((chunk->fd = dup(job->fd)) < 0)
+			{
+				slog(false,"Can't duplicate the descriptor of the file %s: %s\n",job->path,strerror(errno));
+				free_hash_job(chunk);
+				status = FAILURE;
+				break;
+			}
+
+			chunk->direct = job->direct;
+			chunk->stat.st_size = job->stat.st_size;
+			chunk->algorithm = algorithm;
+			chunk->chunk = next;
+			chunk->offset = (sqlite3_int64)next * TREE_CHUNK_SIZE;
+			chunk->length = job->stat.st_size - chunk->offset;
+
+			if(chunk->length > TREE_CHUNK_SIZE)
+			{
+				chunk->length = TREE_CHUNK_SIZE;
+			}
+
+			next++;
+
+			if(config->threads == 0)
+			{
+				/* Hash the chunk right here */
+				chunk->status = tree_hash_chunk(chunk);
+
+				// The root hash could go on
+				status = chunk_done(tree,chunk);
+				break;
+
+			} else {
+
+				if(SUCCESS != (status = hashing_pool_submit(chunk)))
+				{
+					free_hash_job(chunk);
+					break;
+				}
+				in_flight++;
+			}
+		}
+
+		if(SUCCESS != status)
+		{
+			break;
+		}
+
+		if(in_flight > 0)
+		{
+			in_flight--;
+			status = chunk_done(tree,hashing_pool_done(true));
+
+		} else if(global_interrupt_flag == true || config->threads > 0)
+		{
+			break;
+		}
+	}
+
+	/* Chunks finished before the interruption or an error are
+	 * still saved, so they will not be hashed once again */
+	while(in_flight > 0)
+	{
+		in_flight--;
+
+		Return chunk_status = chunk_done(tree,hashing_pool_done(true));
+
+		if(SUCCESS == status)
+		{
+			status = chunk_status;
+		}
+	}
+
+	if(SUCCESS != status)
+	{
+		return(status);
+	}
+
+	if(tree->hashed == chunks)
+	{
+		job->offset = 0;
+		status = hash_final(algorithm,&tree->root,job->checksum);
+
+	} else {
+
+		job->offset = tree_progress(job);
+
+		if(job->offset == saved_offset)
+		{
+			// Nothing new to save against the DB
+			job->skipped = true;
+		}
+	}
+
+	return(status);
+}